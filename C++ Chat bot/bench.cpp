@@ -0,0 +1,521 @@
+/**
+ *  bench.cpp — End-to-end benchmark suite for the chat engine
+ *
+ *  Measures what one message costs on the path the front ends take —
+ *  normalize the line, pin the knowledge base, respond() — for each kind
+ *  of match, typo and word lookups in a large compiled image, plus
+ *  startup (the knowledge base a ChatBot is created with:
+ *  built-in, or a large compiled image; a server's session snapshots and
+ *  resuming one of them) and throughput over a large mixed corpus.
+ *
+ *  Every message is timed on its own; the report gives p50/p99/p999 and
+ *  heap allocations per message (counted by a replacement operator new
+ *  in this file). Results are also written as JSON, one object with a
+ *  fixed set of keys, so runs of different versions can be diffed.
+ *
+ *  Build & run:  make bench            (writes bench_results.json)
+ *                ./chat_bench [OUT.json]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "engine.hpp"
+#include "fuzzy.hpp"
+#include "kb_store.hpp"
+#include "snapshot.hpp"
+#include "util.hpp"
+
+// ─── Allocation Counter ─────────────────────────────────────────
+// The benchmark is single-threaded, so a plain counter is enough.
+
+static uint64_t g_allocations = 0;
+
+void* operator new(std::size_t size) {
+    ++g_allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    double nsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+
+    struct Stats {
+        std::string name;
+        size_t      messages = 0;
+        double      mean = 0, p50 = 0, p99 = 0, p999 = 0;   // ns
+        double      allocations = 0;                          // per message
+    };
+
+    // Percentiles by nearest rank
+    Stats summarize(std::string name, std::vector<double>& samples, uint64_t allocations) {
+        Stats s;
+        s.name = std::move(name);
+        s.messages = samples.size();
+        if (samples.empty()) return s;
+        std::sort(samples.begin(), samples.end());
+        auto rank = [&samples](double q) {
+            size_t i = static_cast<size_t>(q * static_cast<double>(samples.size()));
+            return samples[std::min(i, samples.size() - 1)];
+        };
+        double sum = 0;
+        for (double v : samples) sum += v;
+        s.mean = sum / static_cast<double>(samples.size());
+        s.p50  = rank(0.50);
+        s.p99  = rank(0.99);
+        s.p999 = rank(0.999);
+        s.allocations = static_cast<double>(allocations) / static_cast<double>(samples.size());
+        return s;
+    }
+
+    // ── Message Cases ───────────────────────────────────────────
+
+    struct Case {
+        std::string              name;
+        Intent                   intent;     // every message must resolve to this
+        bool                     calculator;
+        std::vector<std::string> messages;   // raw, as typed
+    };
+
+    std::vector<Case> messageCases() {
+        return {
+            {"exact", Intent::Exact, false,
+             {"hello", "How are you?", "what is c++?", "thanks", "Who made you?", "good morning"}},
+            {"alias", Intent::Alias, false,
+             {"sup", "what is your name", "  Who Created You  ", "thx", "are you a bot?", "gm"}},
+            {"substring", Intent::Partial, false,
+             {"well hello there my friend", "so what is c++? tell me", "i just wanted to say thanks a lot",
+              "ok then, what's up?", "honestly are you human? be truthful"}},
+            {"fuzzy", Intent::Fuzzy, false,
+             {"helo", "whats yur name?", "who mde you?", "are you a robt?", "good mornin"}},
+            {"search", Intent::Search, false,
+             {"can you tell me what c++ is", "tell me who made you please", "are you actually a real robot",
+              "how are you doing today", "i wonder what your name is"}},
+            {"miss", Intent::Miss, false,
+             {"purple elephants dance", "xyzzy", "the quick brown fox jumps over the lazy dog",
+              "what is the airspeed velocity of an unladen swallow", "qwertyuiop"}},
+            {"unicode", Intent::Miss, false,
+             {"Merhaba, nasılsın?", "İSTANBUL'DA HAVA NASIL", "GRÜSSE AUS MÜNCHEN", "ΚΑΛΗΜΈΡΑ ΚΌΣΜΕ",
+              "Ça va très bien"}},
+            {"reverse", Intent::Reverse, false,
+             {"reverse hello world", "reverse the quick brown fox", "reverse Ça va 👍🏽", "reverse İstanbul 🇹🇷"}},
+            {"calculator", Intent::Calculator, true,
+             {"42 + 18", "(5 + 3) * 2", "sqrt(2) * 10", "2 ^ 10 - 1", "100 / 7", "r = 4", "pi * r ^ 2"}},
+        };
+    }
+
+    // One message the way the front ends process it
+    Intent processMessage(KnowledgeStore::Reader& reader, Session& session,
+                          std::string& line, const std::string& raw) {
+        line.assign(raw);
+        Util::normalizeInPlace(line);
+        auto kb = reader.pin();
+        return respond(*kb, session, line).intent;
+    }
+
+    bool runCase(KnowledgeStore& store, const Case& c, size_t count, Stats& out) {
+        KnowledgeStore::Reader reader(store);
+        Session session;
+        if (c.calculator) session.stage = Stage::Calculator;
+        std::string line;
+        line.reserve(256);
+
+        // Warm-up, and a check that the corpus measures what it claims
+        for (const auto& raw : c.messages) {
+            Intent got = processMessage(reader, session, line, raw);
+            if (got != c.intent) {
+                std::fprintf(stderr, "bench: \"%s\" resolved as %s, expected %s\n", raw.c_str(),
+                             std::string(intentName(got)).c_str(), std::string(intentName(c.intent)).c_str());
+                return false;
+            }
+        }
+
+        std::vector<double> samples;
+        samples.reserve(count);
+        uint64_t allocations = g_allocations;
+        for (size_t i = 0; i < count; ++i) {
+            const std::string& raw = c.messages[i % c.messages.size()];
+            auto start = Clock::now();
+            processMessage(reader, session, line, raw);
+            samples.push_back(nsSince(start));
+        }
+        allocations = g_allocations - allocations;
+        out = summarize(c.name, samples, allocations);
+        return true;
+    }
+
+    // ── Startup ─────────────────────────────────────────────────
+
+    constexpr size_t LARGE_KB_KEYS = 100000;
+
+    // Synthetic knowledge base: phrases of pseudo-words
+    Kb::Source syntheticSource(size_t keys) {
+        static const char* const SYLLABLES[] = {"ka", "lo", "mi", "ne", "ru", "ta", "vo", "zi",
+                                                "bra", "cle", "dro", "fin", "gal", "hux", "jem", "pol"};
+        Kb::Source src;
+        uint32_t state = 12345;
+        auto next = [&state] { state = state * 1664525u + 1013904223u; return state >> 8; };
+        auto word = [&] {
+            std::string w;
+            for (unsigned n = 2 + next() % 3; n > 0; --n) w += SYLLABLES[next() % 16];
+            return w;
+        };
+        while (src.responses.size() < keys) {
+            std::string key = word();
+            for (unsigned n = 1 + next() % 3; n > 0; --n) key += ' ' + word();
+            src.responses[key] = "reply " + std::to_string(src.responses.size());
+        }
+        return src;
+    }
+
+    // Free-form questions against the synthetic image: keys with their
+    // words reversed and filler words around them, which only the word
+    // index can place (those that happen to contain another key are
+    // left out)
+    Case relatedCase(const Kb::Source& src) {
+        Case c{"search_100k", Intent::Search, false, {}};
+        size_t i = 0;
+        for (const auto& [key, value] : src.responses) {
+            if (i++ % 997 != 0) continue;
+            std::string msg = "so";
+            size_t end = key.size();
+            while (end > 0) {
+                size_t begin = key.rfind(' ', end - 1);
+                begin = begin == std::string::npos ? 0 : begin + 1;
+                msg += ' ' + key.substr(begin, end - begin);
+                end = begin > 0 ? begin - 1 : 0;
+            }
+            msg += " please";
+            bool contained = false;
+            for (const auto& [other, reply] : src.responses)
+                if (msg.find(other) != std::string::npos) contained = true;
+            if (!contained) c.messages.push_back(msg);
+        }
+        return c;
+    }
+
+    // Keys of the synthetic image with one or two typos — a byte
+    // replaced, dropped or doubled, anywhere in the key — that are not
+    // keys themselves
+    std::vector<std::string> typoQueries(const Kb::Source& src) {
+        std::vector<std::string> queries;
+        uint32_t state = 4242;
+        auto next = [&state] { state = state * 1664525u + 1013904223u; return state >> 8; };
+        size_t i = 0;
+        for (const auto& [key, value] : src.responses) {
+            if (i++ % 97 != 0 || key.size() > 60) continue;
+            std::string q = key;
+            for (unsigned typos = 1 + next() % 2; typos > 0; --typos) {
+                size_t at = next() % q.size();
+                switch (next() % 3) {
+                    case 0:  q[at] = q[at] == 'x' ? 'y' : 'x'; break;
+                    case 1:  q.erase(at, 1); break;
+                    default: q.insert(at, 1, q[at]); break;
+                }
+            }
+            if (src.responses.count(q) == 0) queries.push_back(q);
+        }
+        return queries;
+    }
+
+    // findFuzzy() alone at 100k keys; the fuzzy rows measure the whole
+    // message path on the built-in knowledge
+    bool runFuzzy(const KnowledgeBase& kb, const std::vector<std::string>& queries, size_t count,
+                  Stats& out) {
+        for (const std::string& q : queries) {
+            if (!kb.findFuzzy(q, Fuzzy::DEFAULT_DISTANCE).found) {
+                std::fprintf(stderr, "bench: typo \"%s\" was not matched\n", q.c_str());
+                return false;
+            }
+        }
+
+        std::vector<double> samples;
+        samples.reserve(count);
+        uint64_t allocations = g_allocations;
+        for (size_t i = 0; i < count; ++i) {
+            const std::string& q = queries[i % queries.size()];
+            auto start = Clock::now();
+            kb.findFuzzy(q, Fuzzy::DEFAULT_DISTANCE);
+            samples.push_back(nsSince(start));
+        }
+        out = summarize("fuzzy_100k", samples, g_allocations - allocations);
+        return true;
+    }
+
+    std::vector<Stats> runStartup(const std::string& imagePath) {
+        std::vector<Stats> results;
+        const int rounds = 20;
+
+        std::vector<double> samples;
+        uint64_t allocations = g_allocations;
+        for (int i = 0; i < rounds; ++i) {
+            auto start = Clock::now();
+            KnowledgeBase kb;   // attaches the embedded image
+            samples.push_back(nsSince(start));
+        }
+        results.push_back(summarize("builtin", samples, g_allocations - allocations));
+
+        samples.clear();
+        allocations = g_allocations;
+        for (int i = 0; i < rounds; ++i) {
+            auto start = Clock::now();
+            KnowledgeBase kb;   // as main() does for --kb: construct, then map
+            std::string error;
+            if (!kb.load(imagePath, error)) {
+                std::fprintf(stderr, "bench: %s\n", error.c_str());
+                break;
+            }
+            samples.push_back(nsSince(start));
+        }
+        results.push_back(summarize("image_100k", samples, g_allocations - allocations));
+        return results;
+    }
+
+    constexpr size_t PARKED_SESSIONS = 100000;
+
+    // A server restart with PARKED_SESSIONS named sessions of eight
+    // messages each: opening the compacted snapshot file, then resuming
+    // sessions as their clients come back
+    bool runSnapshots(std::vector<Stats>& results) {
+        const std::string path = "bench_sessions.snap";
+        std::remove(path.c_str());
+        std::vector<std::string> names;
+        for (size_t i = 0; i < PARKED_SESSIONS; ++i) names.push_back("user-" + std::to_string(i));
+
+        std::string error;
+        {
+            SnapshotStore store;
+            if (!store.open(path, error)) {
+                std::fprintf(stderr, "bench: %s\n", error.c_str());
+                return false;
+            }
+            Session session;
+            for (const std::string& name : names) {
+                uint64_t cursor = 0;
+                session.reset();
+                store.attach(name, session, cursor);
+                for (int m = 0; m < 8; ++m) {
+                    ++session.messageCount;
+                    session.history.push("what is c++");
+                    store.record(name, session, "what is c++", cursor);
+                }
+                store.detach(name, cursor, false);
+            }
+            if (!store.compact(error)) {
+                std::fprintf(stderr, "bench: %s\n", error.c_str());
+                return false;
+            }
+        }
+
+        std::vector<double> samples;
+        uint64_t allocations = g_allocations;
+        for (int i = 0; i < 20; ++i) {
+            SnapshotStore store;
+            auto start = Clock::now();
+            bool ok = store.open(path, error);
+            samples.push_back(nsSince(start));
+            if (!ok) {
+                std::fprintf(stderr, "bench: %s\n", error.c_str());
+                return false;
+            }
+        }
+        results.push_back(summarize("snapshots_100k", samples, g_allocations - allocations));
+
+        SnapshotStore store;
+        store.open(path, error);
+        Session session;
+        samples.clear();
+        allocations = g_allocations;
+        for (size_t i = 0; i < PARKED_SESSIONS; i += 97) {
+            uint64_t cursor = 0;
+            auto start = Clock::now();
+            SnapshotStore::Attach result = store.attach(names[i], session, cursor);
+            samples.push_back(nsSince(start));
+            if (result != SnapshotStore::Attach::Resumed || session.history.total() != 8) {
+                std::fprintf(stderr, "bench: session %s was not restored\n", names[i].c_str());
+                return false;
+            }
+            store.detach(names[i], cursor, false);
+        }
+        results.push_back(summarize("resume_100k", samples, g_allocations - allocations));
+        std::remove(path.c_str());
+        return true;
+    }
+
+    // ── Throughput ──────────────────────────────────────────────
+
+    struct Throughput {
+        size_t messages = 0;
+        double seconds = 0;
+        double perSecond = 0;
+        double allocations = 0;
+    };
+
+    // A large mixed corpus against the synthetic image: mostly known
+    // phrases, some with extra words or typos, some unknown
+    Throughput runThroughput(const std::string& imagePath, const Kb::Source& src, size_t count) {
+        std::vector<std::string> keys;
+        for (const auto& [key, value] : src.responses) keys.push_back(key);
+
+        std::vector<std::string> corpus;
+        corpus.reserve(count);
+        uint32_t state = 777;
+        auto next = [&state] { state = state * 1664525u + 1013904223u; return state >> 8; };
+        for (size_t i = 0; i < count; ++i) {
+            std::string msg = keys[next() % keys.size()];
+            switch (next() % 10) {
+                case 0: case 1: msg = "hey " + msg + " please"; break;   // substring
+                case 2: msg[next() % msg.size()] = 'x'; break;              // typo
+                case 3: msg = "nothing like this " + std::to_string(i); break;
+                default: break;                                            // exact
+            }
+            corpus.push_back(std::move(msg));
+        }
+
+        auto kb = std::make_unique<KnowledgeBase>();
+        std::string error;
+        if (!kb->load(imagePath, error)) {
+            std::fprintf(stderr, "bench: %s\n", error.c_str());
+            return {};
+        }
+        KnowledgeStore store(std::move(kb), imagePath);
+        KnowledgeStore::Reader reader(store);
+        Session session;
+        std::string line;
+        line.reserve(256);
+
+        Throughput t;
+        uint64_t allocations = g_allocations;
+        auto start = Clock::now();
+        for (const auto& raw : corpus) processMessage(reader, session, line, raw);
+        t.seconds = nsSince(start) / 1e9;
+        t.messages = corpus.size();
+        t.perSecond = static_cast<double>(t.messages) / t.seconds;
+        t.allocations = static_cast<double>(g_allocations - allocations) / static_cast<double>(t.messages);
+        return t;
+    }
+
+    // ── Report ──────────────────────────────────────────────────
+
+    void printRow(const Stats& s) {
+        std::printf("  %-16s %9zu %10.0f %10.0f %10.0f %10.0f %8.2f\n", s.name.c_str(), s.messages,
+                    s.mean, s.p50, s.p99, s.p999, s.allocations);
+    }
+
+    void writeStats(std::FILE* f, const std::vector<Stats>& list) {
+        for (size_t i = 0; i < list.size(); ++i) {
+            const Stats& s = list[i];
+            std::fprintf(f,
+                         "    \"%s\": {\"messages\": %zu, \"mean_ns\": %.1f, \"p50_ns\": %.1f, "
+                         "\"p99_ns\": %.1f, \"p999_ns\": %.1f, \"allocs_per_message\": %.3f}%s\n",
+                         s.name.c_str(), s.messages, s.mean, s.p50, s.p99, s.p999, s.allocations,
+                         i + 1 < list.size() ? "," : "");
+        }
+    }
+
+    bool writeJson(const std::string& path, const std::vector<Stats>& messages,
+                   const std::vector<Stats>& startup, const Throughput& t) {
+        std::FILE* f = std::fopen(path.c_str(), "w");
+        if (!f) {
+            std::perror(("bench: " + path).c_str());
+            return false;
+        }
+        std::fprintf(f, "{\n  \"format\": 1,\n  \"timestamp\": %lld,\n  \"messages\": {\n",
+                     static_cast<long long>(std::time(nullptr)));
+        writeStats(f, messages);
+        std::fprintf(f, "  },\n  \"startup\": {\n");
+        writeStats(f, startup);
+        std::fprintf(f,
+                     "  },\n  \"throughput\": {\"messages\": %zu, \"seconds\": %.3f, "
+                     "\"messages_per_second\": %.0f, \"allocs_per_message\": %.3f}\n}\n",
+                     t.messages, t.seconds, t.perSecond, t.allocations);
+        return std::fclose(f) == 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    const std::string jsonPath = argc > 1 ? argv[1] : "bench_results.json";
+    const size_t perCase = 200000;
+    const size_t corpusSize = 1000000;
+
+    // Per-message latency on the built-in knowledge base. The plain
+    // rows run without the intent cache, so they measure the matching
+    // itself; the _cached rows repeat the cacheable cases with it.
+    KnowledgeStore builtin(std::make_unique<KnowledgeBase>(0), "");
+    KnowledgeStore cached(std::make_unique<KnowledgeBase>(), "");
+    std::vector<Stats> messages;
+    std::vector<Case> cases = messageCases();
+    for (const Case& c : cases) {
+        Stats s;
+        if (!runCase(builtin, c, perCase, s)) return 1;
+        messages.push_back(s);
+    }
+    for (Case c : cases) {
+        if (c.intent != Intent::Partial && c.intent != Intent::Fuzzy && c.intent != Intent::Search &&
+            c.intent != Intent::Miss)
+            continue;
+        c.name += "_cached";
+        Stats s;
+        if (!runCase(cached, c, perCase, s)) return 1;
+        messages.push_back(s);
+    }
+
+    // A large compiled image on disk, for startup and throughput
+    const std::string imagePath = "bench_kb.kbin";
+    Kb::Source large = syntheticSource(LARGE_KB_KEYS);
+    {
+        std::vector<unsigned char> image = Kb::build(large);
+        std::FILE* f = std::fopen(imagePath.c_str(), "wb");
+        if (!f || std::fwrite(image.data(), 1, image.size(), f) != image.size()) {
+            std::perror("bench: writing the synthetic image");
+            if (f) std::fclose(f);
+            return 1;
+        }
+        std::fclose(f);
+    }
+    {
+        auto kb = std::make_unique<KnowledgeBase>(0);
+        Stats s;
+        std::string error;
+        if (!kb->load(imagePath, error)) {
+            std::fprintf(stderr, "bench: %s\n", error.c_str());
+            return 1;
+        }
+        if (!runFuzzy(*kb, typoQueries(large), perCase, s)) return 1;
+        messages.push_back(s);
+        KnowledgeStore store(std::move(kb), imagePath);
+        if (!runCase(store, relatedCase(large), perCase, s)) return 1;
+        messages.push_back(s);
+    }
+    std::vector<Stats> startup = runStartup(imagePath);
+    if (!runSnapshots(startup)) return 1;
+    Throughput throughput = runThroughput(imagePath, large, corpusSize);
+    std::remove(imagePath.c_str());
+
+    std::printf("per message (ns)   messages       mean        p50        p99       p999   allocs\n");
+    for (const Stats& s : messages) printRow(s);
+    std::printf("\nstartup (ns)         rounds       mean        p50        p99       p999   allocs\n");
+    for (const Stats& s : startup) printRow(s);
+    std::printf("\nthroughput: %zu mixed messages against %zu keys in %.3f s = %.0f messages/s, "
+                "%.2f allocs/message\n",
+                throughput.messages, LARGE_KB_KEYS, throughput.seconds, throughput.perSecond,
+                throughput.allocations);
+
+    if (!writeJson(jsonPath, messages, startup, throughput)) return 1;
+    std::printf("\nresults written to %s\n", jsonPath.c_str());
+    return 0;
+}
@@ -0,0 +1,441 @@
+/**
+ *  check.cpp — Brute-force checks of the engine's indexed lookups
+ *
+ *  Every index answers a question a plain scan could answer too, only
+ *  faster. Each check here builds its index over generated data, asks
+ *  it thousands of questions and compares every answer with the scan,
+ *  which applies the same rules the obvious way:
+ *
+ *    fuzzy    Image::findFuzzy() — deletion index up to two edits,
+ *             trigram index beyond — against the edit distance to
+ *             every key, with the same tie rules
+ *    search   Image::findRelated() — anchor lists, bound skipping,
+ *             varint coding — against BM25 over every key, with the
+ *             IDF and length factors from Search::IndexBuilder
+ *    snapshot SnapshotStore — sessions parked, resumed and ended across
+ *             reopens and a compaction, then a torn last record —
+ *             against the state each session had when it was parked
+ *
+ *  Data and questions come from fixed seeds, so a failure repeats.
+ *
+ *  Build & run:  make check
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "engine.hpp"
+#include "fuzzy.hpp"
+#include "kb_image.hpp"
+#include "random.hpp"
+#include "search.hpp"
+#include "snapshot.hpp"
+
+namespace {
+
+    // Prints a mismatch; only the first few of a check are shown
+    struct Failures {
+        const char* check;
+        size_t      count = 0;
+
+        void report(const std::string& question, const std::string& expected, const std::string& got) {
+            if (++count <= 10)
+                std::fprintf(stderr, "check %s: \"%s\": expected %s, got %s\n", check, question.c_str(),
+                             expected.c_str(), got.c_str());
+        }
+
+        bool summary(size_t questions) const {
+            std::printf("  %-10s %8zu questions  %s\n", check, questions, count == 0 ? "ok" : "FAILED");
+            if (count > 10) std::fprintf(stderr, "check %s: %zu more mismatches\n", check, count - 10);
+            return count == 0;
+        }
+    };
+
+    // ── Typo Lookups ────────────────────────────────────────────
+
+    unsigned levenshtein(std::string_view a, std::string_view b) {
+        std::vector<unsigned> row(b.size() + 1);
+        std::iota(row.begin(), row.end(), 0u);
+        for (size_t i = 1; i <= a.size(); ++i) {
+            unsigned diagonal = row[0];
+            row[0] = static_cast<unsigned>(i);
+            for (size_t j = 1; j <= b.size(); ++j) {
+                unsigned above = row[j];
+                row[j] = std::min({row[j] + 1, row[j - 1] + 1, diagonal + (a[i - 1] != b[j - 1])});
+                diagonal = above;
+            }
+        }
+        return row[b.size()];
+    }
+
+    // Phrases of pseudo-words, and near twins of some of them (so ties
+    // come up), plus short keys that allow a single typo
+    std::vector<std::string> fuzzyKeys(Random& random) {
+        static const char* const SYLLABLES[] = {"ka", "lo", "mi", "ne", "ru", "ta", "vo", "zi",
+                                                "bra", "cle", "dro", "fin", "gal", "hux", "jem", "pol"};
+        auto word = [&] {
+            std::string w;
+            for (int n = random.between(1, 4); n > 0; --n) w += SYLLABLES[random.below(16)];
+            return w;
+        };
+        std::vector<std::string> keys;
+        while (keys.size() < 8000) {
+            std::string key = word();
+            for (int n = random.between(0, 5); n > 0; --n) key += ' ' + word();
+            keys.push_back(key);
+            if (random.below(4) == 0) {
+                key[random.below(static_cast<uint32_t>(key.size()))] = 'x';
+                keys.push_back(key);
+            }
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        return keys;
+    }
+
+    // A key with up to `edits` random replacements, deletions,
+    // insertions and swaps of adjacent bytes
+    std::string typo(std::string s, unsigned edits, Random& random) {
+        static const char LETTERS[] = "abcdefghijklmnopqrstuvwxyz ";
+        for (unsigned e = 0; e < edits && !s.empty(); ++e) {
+            const size_t at = random.below(static_cast<uint32_t>(s.size()));
+            const char letter = LETTERS[random.below(sizeof LETTERS - 1)];
+            switch (random.below(4)) {
+                case 0: s[at] = letter; break;
+                case 1: s.erase(at, 1); break;
+                case 2: s.insert(s.begin() + static_cast<std::ptrdiff_t>(at), letter); break;
+                default: if (at + 1 < s.size()) std::swap(s[at], s[at + 1]); break;
+            }
+        }
+        return s;
+    }
+
+    bool checkFuzzy() {
+        Random random(9);
+        const std::vector<std::string> keys = fuzzyKeys(random);
+        Kb::Source source;
+        for (const std::string& key : keys) source.responses[key] = key;
+        const std::vector<unsigned char> bytes = Kb::build(source);
+        Kb::Image image;
+        std::string error;
+        if (!image.attach(bytes.data(), bytes.size(), error)) {
+            std::fprintf(stderr, "check fuzzy: %s\n", error.c_str());
+            return false;
+        }
+
+        // Keys are ids in sorted order, as the builder assigns them
+        Failures failures{"fuzzy"};
+        size_t questions = 0;
+        for (unsigned maxDistance : {Fuzzy::DEFAULT_DISTANCE, Fuzzy::DELETE_DEPTH + 2}) {
+            for (int q = 0; q < 2000; ++q) {
+                std::string input = typo(keys[random.below(static_cast<uint32_t>(keys.size()))],
+                                         random.below(maxDistance + 2), random);
+                if (q % 10 == 0) input = typo(input + ' ' + input, 4, random);   // some past MAX_PATTERN
+
+                const unsigned k = Fuzzy::allowedDistance(input.size(), maxDistance);
+                size_t best = keys.size();
+                unsigned bestDistance = k + 1;
+                size_t bestGap = 0;
+                if (k > 0 && input.size() <= Fuzzy::MAX_PATTERN) {   // exact matches are find()'s
+                    for (size_t id = 0; id < keys.size(); ++id) {
+                        const size_t gap = keys[id].size() > input.size() ? keys[id].size() - input.size()
+                                                                          : input.size() - keys[id].size();
+                        if (gap > k) continue;
+                        const unsigned d = levenshtein(input, keys[id]);
+                        if (d < bestDistance || (d == bestDistance && gap < bestGap)) {
+                            best = id;
+                            bestDistance = d;
+                            bestGap = gap;
+                        }
+                    }
+                }
+
+                const Kb::Image::Lookup got = image.findFuzzy(input, maxDistance);
+                const std::string expected = best < keys.size() ? '"' + keys[best] + '"' : "no match";
+                const std::string found = got.found ? '"' + std::string(got.key) + '"' : "no match";
+                if (expected != found) failures.report(input, expected, found);
+                ++questions;
+            }
+        }
+        return failures.summary(questions);
+    }
+
+    // ── Word Lookups ────────────────────────────────────────────
+
+    // Questions made of a few common words and many rarer ones, so IDF
+    // and anchors vary from key to key
+    std::vector<std::string> searchWords() {
+        std::vector<std::string> words = {"what", "is", "the", "a", "you", "how", "do", "i", "can", "me",
+                                          "tell", "about", "your", "my", "are", "to", "of", "in", "it", "c++"};
+        static const char* const SYLLABLES[] = {"ba", "de", "fo", "gu", "ki", "lo", "ma", "ne",
+                                                "pi", "ro", "su", "ta", "vi", "wo", "ya", "ze"};
+        for (unsigned i = 0; words.size() < 2000; ++i)
+            words.push_back(std::string(SYLLABLES[i % 16]) + SYLLABLES[i / 16 % 16] + SYLLABLES[i / 256 % 16]);
+        return words;
+    }
+
+    bool checkSearch() {
+        Random random(16);
+        const std::vector<std::string> words = searchWords();
+        auto pick = [&]() -> const std::string& {
+            // Skewed: low indexes, the common words among them, come up most
+            return words[random.below(random.below(static_cast<uint32_t>(words.size())) + 1)];
+        };
+
+        Kb::Source source;
+        while (source.responses.size() < 6000) {
+            std::string key = pick();
+            for (int n = random.between(1, 7); n > 0; --n) key += ' ' + pick();
+            source.responses[key] = key;
+        }
+        std::vector<std::string_view> keys;
+        for (const auto& [key, reply] : source.responses) keys.push_back(key);
+
+        const std::vector<unsigned char> bytes = Kb::build(source);
+        Kb::Image image;
+        std::string error;
+        if (!image.attach(bytes.data(), bytes.size(), error)) {
+            std::fprintf(stderr, "check search: %s\n", error.c_str());
+            return false;
+        }
+
+        // The same weights the image holds, and each key's distinct words
+        Search::IndexBuilder index;
+        index.build(keys);
+        std::unordered_map<std::string_view, uint32_t> termIds;
+        for (uint32_t t = 0; t + 1 < index.terms().size(); ++t) {
+            const Search::Term& term = index.terms()[t];
+            termIds.emplace(std::string_view(index.text()).substr(term.text, term.length), t);
+        }
+        std::vector<std::vector<uint32_t>> keyTerms(keys.size());
+        for (size_t d = 0; d < keys.size(); ++d) {
+            Search::forEachTerm(keys[d], [&](std::string_view word) { keyTerms[d].push_back(termIds.at(word)); });
+            std::sort(keyTerms[d].begin(), keyTerms[d].end());
+            keyTerms[d].erase(std::unique(keyTerms[d].begin(), keyTerms[d].end()), keyTerms[d].end());
+        }
+
+        Failures failures{"search"};
+        const int questions = 3000;
+        for (int q = 0; q < questions; ++q) {
+            // A key's words, some dropped, shuffled, with others around
+            // them; now and then an unknown word, or more words than a
+            // question may have
+            std::vector<std::string> parts;
+            Search::forEachTerm(keys[random.below(static_cast<uint32_t>(keys.size()))], [&](std::string_view word) {
+                if (random.below(4) != 0) parts.emplace_back(word);
+            });
+            for (int n = random.between(0, q % 50 == 0 ? 40 : 3); n > 0; --n) parts.push_back(pick());
+            if (random.below(8) == 0) parts.push_back("xyzzy");
+            for (size_t i = parts.size(); i > 1; --i)
+                std::swap(parts[i - 1], parts[random.below(static_cast<uint32_t>(i))]);
+            std::string input;
+            for (const std::string& part : parts) input += (input.empty() ? "" : " ") + part;
+
+            // The first MAX_QUERY_TERMS distinct known words, summed in
+            // term id order as the index sums them
+            std::vector<uint32_t> ids;
+            Search::forEachTerm(input, [&](std::string_view word) {
+                auto it = termIds.find(word);
+                if (ids.size() < Search::MAX_QUERY_TERMS && it != termIds.end() &&
+                    std::find(ids.begin(), ids.end(), it->second) == ids.end())
+                    ids.push_back(it->second);
+            });
+            std::sort(ids.begin(), ids.end());
+
+            size_t best = keys.size();
+            float bestScore = 0;
+            for (size_t d = 0; ids.size() >= Search::MIN_MATCHED_TERMS && d < keys.size(); ++d) {
+                float idfSum = 0;
+                unsigned matched = 0;
+                for (uint32_t t : keyTerms[d]) {
+                    if (!std::binary_search(ids.begin(), ids.end(), t)) continue;
+                    idfSum += index.terms()[t].idf;
+                    ++matched;
+                }
+                const float score = index.docNorm()[d] * idfSum;
+                if (matched >= Search::MIN_MATCHED_TERMS && idfSum >= Search::MIN_COVERAGE * index.docWeight()[d] &&
+                    (best == keys.size() || score > bestScore)) {
+                    best = d;
+                    bestScore = score;
+                }
+            }
+
+            const Kb::Image::Lookup got = image.findRelated(input);
+            const std::string expected = best < keys.size() ? '"' + std::string(keys[best]) + '"' : "no match";
+            const std::string found = got.found ? '"' + std::string(got.key) + '"' : "no match";
+            if (expected != found) failures.report(input, expected, found);
+        }
+        return failures.summary(questions);
+    }
+
+    // ── Session Snapshots ───────────────────────────────────────
+
+    // What a session should look like when it is resumed
+    struct Parked {
+        Stage                    stage = Stage::Chat;
+        size_t                   messageCount = 0;
+        uint64_t                 random[4] = {};
+        Expr::Variables          variables;
+        std::vector<std::string> history;   // every message pushed
+        bool                     ended = false;
+    };
+
+    // Attaches `name`, sends it up to `messages` messages and parks or
+    // ends it, keeping `parked` up to date
+    void converse(SnapshotStore& store, const std::string& name, Parked& parked, Random& random,
+                  size_t messages, bool end) {
+        Session session;
+        uint64_t cursor = 0;
+        const bool started = store.attach(name, session, cursor) == SnapshotStore::Attach::Started;
+        if (started) parked = Parked{};
+        for (size_t m = 0; m < messages; ++m) {
+            ++session.messageCount;
+            session.random.next();
+            if (random.below(5) == 0) session.stage = static_cast<Stage>(random.below(4));
+            if (random.below(4) == 0)
+                session.variables["v" + std::to_string(random.below(6))] = random.between(-1000, 1000) / 8.0;
+            std::string message;
+            if (random.below(4) != 0) {
+                message = name + " says " + std::to_string(random.next() % 100000);
+                session.history.push(message);
+                parked.history.push_back(message);
+            }
+            store.record(name, session, message, cursor);
+        }
+        parked.stage        = session.stage;
+        parked.messageCount = session.messageCount;
+        parked.variables    = session.variables;
+        parked.ended        = end || (started && messages == 0);   // nothing recorded: new again
+        session.random.save(parked.random);
+        store.detach(name, cursor, end);
+    }
+
+    // Resumes every session and compares it with what was parked
+    void compareParked(SnapshotStore& store, const std::vector<std::string>& names,
+                       const std::vector<Parked>& parked, const char* stage, Failures& failures) {
+        std::vector<std::string_view> messages;
+        for (size_t i = 0; i < names.size(); ++i) {
+            const Parked& p = parked[i];
+            Session session;
+            uint64_t cursor = 0;
+            const SnapshotStore::Attach result = store.attach(names[i], session, cursor);
+            store.detach(names[i], cursor, false);
+
+            auto describe = [](bool resumed, size_t messageCount) {
+                return resumed ? "resumed, " + std::to_string(messageCount) + " messages" : std::string("a new session");
+            };
+            const std::string expected = describe(!p.ended, p.messageCount);
+            std::string got = describe(result == SnapshotStore::Attach::Resumed, session.messageCount);
+            if (!p.ended && result == SnapshotStore::Attach::Resumed) {
+                // The newest messages come back, as many as fit in RAM
+                const auto available = static_cast<std::ptrdiff_t>(std::min(p.history.size(), History::MAX_ENTRIES));
+                uint64_t random[4];
+                session.random.save(random);
+                session.history.get(0, session.history.total(), messages);
+                bool same = session.stage == p.stage && std::equal(random, random + 4, p.random) &&
+                            session.variables == p.variables && session.history.total() == p.history.size() &&
+                            static_cast<std::ptrdiff_t>(messages.size()) == available &&
+                            std::equal(messages.begin(), messages.end(), p.history.end() - available);
+                if (!same) got += " with other state";
+            }
+            if (expected != got) failures.report(names[i] + " " + stage, expected, got);
+        }
+    }
+
+    bool checkSnapshots() {
+        const std::string path = "check_sessions.snap";
+        std::remove(path.c_str());
+        Random random(22);
+        Failures failures{"snapshot"};
+        std::string error;
+        auto open = [&](SnapshotStore& store) {
+            if (store.open(path, error)) return true;
+            std::fprintf(stderr, "check snapshot: %s\n", error.c_str());
+            return false;
+        };
+
+        std::vector<std::string> names;
+        std::vector<Parked> parked(300);
+        for (size_t i = 0; i < parked.size(); ++i) names.push_back("session-" + std::to_string(i));
+        auto round = [&](SnapshotStore& store, size_t every) {
+            for (size_t i = random.below(static_cast<uint32_t>(every)); i < names.size(); i += every)
+                converse(store, names[i], parked[i], random, random.below(100), random.below(10) == 0);
+        };
+
+        size_t questions = 0;
+        {
+            // Records only, as after a crash; resumed sessions continue
+            // their chains, ended ones start new ones
+            SnapshotStore store;
+            if (!open(store)) return false;
+            round(store, 1);
+            round(store, 3);
+        }
+        {
+            SnapshotStore store;
+            if (!open(store)) return false;
+            compareParked(store, names, parked, "before compaction", failures);
+            round(store, 2);
+            if (!store.compact(error)) {
+                std::fprintf(stderr, "check snapshot: %s\n", error.c_str());
+                return false;
+            }
+        }
+        {
+            // Compacted, then records after the index
+            SnapshotStore store;
+            if (!open(store)) return false;
+            compareParked(store, names, parked, "after compaction", failures);
+            round(store, 5);
+        }
+        {
+            SnapshotStore store;
+            if (!open(store)) return false;
+            compareParked(store, names, parked, "after more records", failures);
+        }
+        questions += 3 * names.size();
+
+        // A crash in the middle of a record: every cut of the last one
+        // leaves the session as it was before it
+        const uintmax_t intact = std::filesystem::file_size(path);
+        const Parked before = parked[0];
+        {
+            SnapshotStore store;
+            if (!open(store)) return false;
+            converse(store, names[0], parked[0], random, 1, false);
+        }
+        const uintmax_t full = std::filesystem::file_size(path);
+        for (uintmax_t size = intact + 1; size < full; size += 5) {
+            std::filesystem::copy_file(path, path + ".torn", std::filesystem::copy_options::overwrite_existing);
+            std::filesystem::resize_file(path + ".torn", size);
+            SnapshotStore store;
+            if (!store.open(path + ".torn", error)) {
+                failures.report(names[0] + " cut to " + std::to_string(size) + " bytes", "opened", error);
+            } else {
+                compareParked(store, {names[0]}, {before}, "after a torn record", failures);
+                store.flush();
+                const uintmax_t left = std::filesystem::file_size(path + ".torn");
+                if (left != intact)
+                    failures.report(names[0] + " cut to " + std::to_string(size) + " bytes",
+                                    std::to_string(intact) + " bytes kept", std::to_string(left));
+            }
+            ++questions;
+        }
+        std::remove((path + ".torn").c_str());
+        std::remove(path.c_str());
+        return failures.summary(questions);
+    }
+}
+
+int main() {
+    std::printf("brute-force checks\n");
+    bool ok = checkFuzzy();
+    ok = checkSearch() && ok;
+    ok = checkSnapshots() && ok;
+    return ok ? 0 : 1;
+}
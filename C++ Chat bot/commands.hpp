@@ -0,0 +1,169 @@
+/**
+ *  commands.hpp — Built-in command dispatch table
+ *
+ *  Every built-in command phrase is placed in a perfect-hash table that
+ *  is generated entirely at compile time: a seed is searched for until
+ *  no two phrases share a slot, so a lookup is one hash, one probe and
+ *  one string comparison regardless of how many phrases exist.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Handler selected for a built-in command phrase
+enum class Command : uint8_t {
+    None,       // not a built-in command
+    Exit,
+    Help,
+    Joke,
+    Fact,
+    Time,
+    Flip,
+    Roll,
+    Uptime,
+    Stats,
+    History,
+    Clear,
+    Calc,
+    Reload
+};
+
+namespace Commands {
+
+    struct Phrase {
+        std::string_view text;
+        Command          command;
+    };
+
+    // ── Phrase list ─────────────────────────────────────────────
+    // Add synonyms here; the table below regenerates at compile time.
+    inline constexpr Phrase PHRASES[] = {
+        {"bye", Command::Exit}, {"exit", Command::Exit},
+        {"quit", Command::Exit}, {"q", Command::Exit},
+
+        {"help", Command::Help}, {"manual", Command::Help},
+        {"commands", Command::Help},
+
+        {"joke", Command::Joke}, {"tell me a joke", Command::Joke},
+        {"tell a joke", Command::Joke},
+
+        {"fact", Command::Fact}, {"tell me a fact", Command::Fact},
+        {"fun fact", Command::Fact},
+
+        {"time", Command::Time}, {"date", Command::Time},
+        {"what time is it?", Command::Time}, {"what time is it", Command::Time},
+        {"what's the time?", Command::Time}, {"what is the date?", Command::Time},
+        {"what is the date", Command::Time},
+
+        {"flip", Command::Flip}, {"flip a coin", Command::Flip},
+        {"coin flip", Command::Flip}, {"coin", Command::Flip},
+
+        {"roll", Command::Roll}, {"roll a dice", Command::Roll},
+        {"roll dice", Command::Roll}, {"dice", Command::Roll},
+
+        {"uptime", Command::Uptime}, {"session", Command::Uptime},
+
+        {"stats", Command::Stats}, {"statistics", Command::Stats},
+
+        {"history", Command::History}, {"show history", Command::History},
+
+        {"clear", Command::Clear}, {"cls", Command::Clear},
+
+        {"calc", Command::Calc}, {"calculate", Command::Calc},
+        {"calculator", Command::Calc}, {"math", Command::Calc},
+        {"add", Command::Calc}, {"sum", Command::Calc},
+        {"add numbers", Command::Calc},
+        {"can you add integers for me?", Command::Calc},
+        {"can you calculate for me?", Command::Calc},
+
+        {"reload", Command::Reload}, {"reload knowledge", Command::Reload},
+    };
+
+    inline constexpr size_t PHRASE_COUNT = sizeof(PHRASES) / sizeof(PHRASES[0]);
+
+    // ── Table generation ────────────────────────────────────────
+
+    inline constexpr size_t  TABLE_SIZE = 256;   // power of two, ≥ 4× phrases
+    inline constexpr uint8_t EMPTY_SLOT = 0xFF;
+
+    static_assert(PHRASE_COUNT < EMPTY_SLOT, "phrase index must fit in a slot byte");
+    static_assert(PHRASE_COUNT * 4 <= TABLE_SIZE, "grow TABLE_SIZE to keep the seed search short");
+
+    // Seeded FNV-1a with a final avalanche step
+    constexpr uint32_t hash(std::string_view s, uint32_t seed) {
+        uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+        for (char c : s) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 16777619u;
+        }
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        return h;
+    }
+
+    constexpr bool isCollisionFree(uint32_t seed) {
+        bool used[TABLE_SIZE] = {};
+        for (const auto& p : PHRASES) {
+            size_t slot = hash(p.text, seed) & (TABLE_SIZE - 1);
+            if (used[slot]) return false;
+            used[slot] = true;
+        }
+        return true;
+    }
+
+    constexpr uint32_t findSeed() {
+        uint32_t seed = 1;
+        while (!isCollisionFree(seed)) ++seed;
+        return seed;
+    }
+
+    inline constexpr uint32_t SEED = findSeed();
+
+    constexpr std::array<uint8_t, TABLE_SIZE> buildTable() {
+        std::array<uint8_t, TABLE_SIZE> table{};
+        for (auto& slot : table) slot = EMPTY_SLOT;
+        for (size_t i = 0; i < PHRASE_COUNT; ++i)
+            table[hash(PHRASES[i].text, SEED) & (TABLE_SIZE - 1)] = static_cast<uint8_t>(i);
+        return table;
+    }
+
+    inline constexpr std::array<uint8_t, TABLE_SIZE> TABLE = buildTable();
+
+    // ── Lookup ──────────────────────────────────────────────────
+
+    // Command for an exact, already-normalized phrase (one probe).
+    constexpr Command lookup(std::string_view input) {
+        uint8_t idx = TABLE[hash(input, SEED) & (TABLE_SIZE - 1)];
+        if (idx == EMPTY_SLOT || PHRASES[idx].text != input) return Command::None;
+        return PHRASES[idx].command;
+    }
+
+    constexpr std::string_view name(Command command) {
+        switch (command) {
+            case Command::None:    return "none";
+            case Command::Exit:    return "exit";
+            case Command::Help:    return "help";
+            case Command::Joke:    return "joke";
+            case Command::Fact:    return "fact";
+            case Command::Time:    return "time";
+            case Command::Flip:    return "flip";
+            case Command::Roll:    return "roll";
+            case Command::Uptime:  return "uptime";
+            case Command::Stats:   return "stats";
+            case Command::History: return "history";
+            case Command::Clear:   return "clear";
+            case Command::Calc:    return "calc";
+            case Command::Reload:  return "reload";
+        }
+        return "none";
+    }
+
+    static_assert(lookup("bye") == Command::Exit);
+    static_assert(lookup("can you calculate for me?") == Command::Calc);
+    static_assert(lookup("hello") == Command::None);
+}
@@ -0,0 +1,98 @@
+/**
+ *  dispatch_bench.cpp — Command dispatch microbenchmark
+ *
+ *  Compares the original if/else chain of string comparisons against
+ *  the compile-time perfect-hash table in commands.hpp, on a message
+ *  mix where most messages are ordinary chat (not commands).
+ *
+ *  Build & run:  make bench-dispatch
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "commands.hpp"
+
+// The dispatch chain as it was in ChatBot::processInput
+static Command legacyDispatch(const std::string& input) {
+    if (input == "bye" || input == "exit" || input == "quit" || input == "q")
+        return Command::Exit;
+    if (input == "help" || input == "manual" || input == "commands")
+        return Command::Help;
+    if (input == "joke" || input == "tell me a joke" || input == "tell a joke")
+        return Command::Joke;
+    if (input == "fact" || input == "tell me a fact" || input == "fun fact")
+        return Command::Fact;
+    if (input == "time" || input == "date" || input == "what time is it?" ||
+        input == "what time is it" || input == "what's the time?" ||
+        input == "what is the date?" || input == "what is the date")
+        return Command::Time;
+    if (input == "flip" || input == "flip a coin" || input == "coin flip" || input == "coin")
+        return Command::Flip;
+    if (input == "roll" || input == "roll a dice" || input == "roll dice" || input == "dice")
+        return Command::Roll;
+    if (input == "uptime" || input == "session")
+        return Command::Uptime;
+    if (input == "history" || input == "show history")
+        return Command::History;
+    if (input == "clear" || input == "cls")
+        return Command::Clear;
+    if (input.substr(0, 8) == "reverse " && input.size() > 8)
+        return Command::None;
+    if (input.substr(0, 6) == "count " && input.size() > 6)
+        return Command::None;
+    if (input == "calc" || input == "calculate" || input == "calculator" ||
+        input == "math" || input == "add" || input == "sum" || input == "add numbers" ||
+        input == "can you add integers for me?" || input == "can you calculate for me?")
+        return Command::Calc;
+    return Command::None;
+}
+
+static volatile unsigned g_sink;  // keeps results observable
+
+template <typename Fn>
+static double nsPerMessage(const std::vector<std::string>& corpus, int rounds, Fn&& dispatch) {
+    unsigned sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r)
+        for (const auto& msg : corpus)
+            sink += static_cast<unsigned>(dispatch(msg));
+    auto end = std::chrono::steady_clock::now();
+
+    g_sink = sink;
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    return ns / (static_cast<double>(rounds) * static_cast<double>(corpus.size()));
+}
+
+int main() {
+    // Roughly 3 chat messages for every command
+    const std::vector<std::string> corpus = {
+        "hi", "hello", "how are you?", "joke",
+        "what is c++?", "thanks", "i like turtles", "roll",
+        "who made you?", "good morning", "what's up?", "calc",
+        "can you tell me something interesting", "lol", "cool", "what time is it?",
+        "are you a robot?", "ok", "nice", "bye",
+    };
+    const int rounds = 500000;
+
+    // Sanity: both dispatchers must agree on every message
+    for (const auto& msg : corpus) {
+        if (legacyDispatch(msg) != Commands::lookup(msg)) {
+            std::fprintf(stderr, "mismatch on '%s'\n", msg.c_str());
+            return 1;
+        }
+    }
+
+    double legacy = nsPerMessage(corpus, rounds, legacyDispatch);
+    double table  = nsPerMessage(corpus, rounds, [](const std::string& s) {
+        return Commands::lookup(s);
+    });
+
+    std::printf("command dispatch (%zu messages x %d rounds)\n", corpus.size(), rounds);
+    std::printf("  if/else chain      : %7.2f ns/message\n", legacy);
+    std::printf("  perfect-hash table : %7.2f ns/message\n", table);
+    std::printf("  speedup            : %7.2fx\n", legacy / table);
+    return 0;
+}
@@ -0,0 +1,461 @@
+/**
+ *  engine.cpp — Knowledge tables and message resolution
+ */
+
+#include "engine.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "metrics.hpp"
+#include "utf8.hpp"
+#include "util.hpp"
+
+std::string_view intentName(Intent intent) {
+    switch (intent) {
+        case Intent::Command:    return "command";
+        case Intent::Reverse:    return "reverse";
+        case Intent::Count:      return "count";
+        case Intent::Alias:      return "alias";
+        case Intent::Exact:      return "exact";
+        case Intent::Partial:    return "partial";
+        case Intent::Fuzzy:      return "fuzzy";
+        case Intent::Search:     return "search";
+        case Intent::Miss:       return "miss";
+        case Intent::Welcome:    return "welcome";
+        case Intent::Calculator: return "calculator";
+    }
+    return "unknown";
+}
+
+// ─── Knowledge Base ─────────────────────────────────────────────
+
+// The built-in content: knowledge.txt, compiled by `kbc --cpp`
+namespace Builtin {
+#include "knowledge.inc"
+}
+
+KnowledgeBase::KnowledgeBase(size_t cacheEntries) : cache_(cacheEntries) {
+    std::string error;
+    image_.attach(Builtin::IMAGE, sizeof Builtin::IMAGE, error);
+}
+
+bool KnowledgeBase::load(const std::string& path, std::string& error) {
+    MappedFile file;
+    Kb::Image image;
+    if (!file.open(path, error)) return false;
+    if (!image.attach(file.data(), file.size(), error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    mapped_ = std::move(file);
+    image_  = image;
+    cache_.clear();
+    return true;
+}
+
+KnowledgeBase::Entry KnowledgeBase::findNearest(std::string_view input, unsigned maxDistance,
+                                                Intent& intent) const {
+    const uint64_t hash = IntentCache::hash(input, maxDistance);
+    IntentCache::Resolution cached;
+    if (cache_.get(hash, cached)) {
+        intent = cached.intent;
+        return intent == Intent::Miss ? Entry{} : image_.entry(cached.response, false);
+    }
+
+    Entry entry = image_.findPartial(input);
+    if (entry.found) {
+        intent = Intent::Partial;
+    } else if ((entry = image_.findFuzzy(input, maxDistance)).found) {
+        intent = Intent::Fuzzy;
+    } else if ((entry = image_.findRelated(input)).found) {
+        intent = Intent::Search;
+    } else {
+        intent = Intent::Miss;
+    }
+    cache_.put(hash, {intent, entry.response});
+    return entry;
+}
+
+std::string_view KnowledgeBase::randomJoke(Random& random) const {
+    size_t n = image_.jokeCount();
+    if (n == 0) return "I'm all out of jokes right now!";
+    return image_.joke(random.below(static_cast<uint32_t>(n)));
+}
+
+std::string_view KnowledgeBase::randomFact(Random& random) const {
+    size_t n = image_.factCount();
+    if (n == 0) return "I don't know any fun facts yet!";
+    return image_.fact(random.below(static_cast<uint32_t>(n)));
+}
+
+// ─── Session ────────────────────────────────────────────────────
+
+void Session::reset() {
+    start         = std::chrono::steady_clock::now();
+    messageCount  = 0;
+    stage         = Stage::Chat;
+    keepHistory   = true;
+    fuzzyDistance = Fuzzy::DEFAULT_DISTANCE;
+    random.reseed(Util::randomSeed());
+    variables.clear();
+    history.clear();
+}
+
+// ─── Welcome ────────────────────────────────────────────────────
+
+static constexpr std::string_view WELCOME_QUESTION = "Welcome! Would you like to start chatting? (y/n)";
+static constexpr std::string_view TOUR_QUESTION    = "Would you like to see what I can do? (y/n)";
+
+std::string_view pendingQuestion(const Session& session) {
+    switch (session.stage) {
+        case Stage::Welcome: return WELCOME_QUESTION;
+        case Stage::Tour:    return TOUR_QUESTION;
+        default:             return {};
+    }
+}
+
+// Anything but "y" or "yes" is a no. Declining the welcome ends the
+// session; either answer to the tour starts the chat, with
+// Command::Help if the commands should be shown.
+static void welcomeLine(Session& session, std::string_view answer, Response& reply) {
+    reply.intent = Intent::Welcome;
+    const bool yes = answer == "y" || answer == "yes";
+
+    if (session.stage == Stage::Welcome) {
+        if (yes) {
+            session.stage = Stage::Tour;
+            reply.text = TOUR_QUESTION;
+        } else {
+            reply.text = "No worries — see you next time! 👋";
+            reply.flags |= Response::EndSession;
+        }
+        return;
+    }
+
+    session.stage = Stage::Chat;
+    if (yes) {
+        reply.command = Command::Help;
+        reply.flags |= Response::ShowHelp;
+    }
+    reply.text = "Let's chat! Type anything or 'help' for commands. Type 'bye' to exit.";
+}
+
+// ─── Calculator ─────────────────────────────────────────────────
+
+// Compiled expressions, shared by the sessions of one thread
+static Expr::Cache& expressionCache() {
+    thread_local Expr::Cache cache;
+    return cache;
+}
+
+static void calculatorLine(Session& session, std::string_view line, Response& reply) {
+    reply.intent = Intent::Calculator;
+    std::string& out = session.replyText;
+
+    if (line == "done" || line == "exit" || line == "back" || line == "quit") {
+        session.stage = Stage::Chat;
+        reply.text = "Exiting calculator. Back to chat! 💬";
+        return;
+    }
+
+    // Compiled once per distinct line, then only evaluated
+    std::string error;
+    const Expr::Program* program = expressionCache().get(line, error);
+    if (!program) {
+        out.assign("⚠️  ").append(error).append(". Try e.g. (5 + 3) * 2, sqrt(2) or r = 4");
+        reply.text = out;
+        return;
+    }
+
+    Expr::Result result = Expr::evaluate(*program, session.variables);
+    switch (result.status) {
+        case Expr::Status::Ok:
+            break;
+        case Expr::Status::UnknownVariable:
+            out.assign("⚠️  Unknown variable '").append(result.detail).append("'. Set it first, e.g. ")
+               .append(result.detail).append(" = 2");
+            reply.text = out;
+            return;
+        case Expr::Status::DivisionByZero:
+            reply.text = "⚠️  Division by zero! The universe would implode. 🌌";
+            return;
+        case Expr::Status::NotFinite:
+            reply.text = "⚠️  The result is not a finite real number.";
+            return;
+    }
+
+    // Assignments must fit in the session's MAX_VARIABLES
+    const Expr::Variables& vars = session.variables;
+    size_t added = vars.count("ans") ? 0 : 1;
+    if (!program->assignTo.empty() && program->assignTo != "ans" && !vars.count(program->assignTo)) ++added;
+    if (vars.size() + added > Expr::MAX_VARIABLES) {
+        out.assign("⚠️  Too many variables (at most ").append(std::to_string(Expr::MAX_VARIABLES))
+           .append("). Reuse a name you already set.");
+        reply.text = out;
+        return;
+    }
+
+    session.variables["ans"] = result.value;
+    if (!program->assignTo.empty()) {
+        session.variables[program->assignTo] = result.value;
+        out.assign("✅ ").append(program->assignTo);
+    } else {
+        out.assign("✅ ").append(line);
+    }
+    out.append(" = ").append(Expr::format(result.value));
+    reply.text = out;
+}
+
+// "history N" pages back through older messages
+static bool parseHistoryPage(std::string_view input, size_t& page) {
+    if (!Util::startsWith(input, "history ")) return false;
+    std::string_view arg = Util::trim(input.substr(8));
+    if (arg.empty() || arg.size() > 9 || arg.find_first_not_of("0123456789") != std::string_view::npos)
+        return false;
+    page = 0;
+    for (char c : arg) page = page * 10 + static_cast<size_t>(c - '0');
+    return page > 0;
+}
+
+// "2.1 µs" style rendering of a latency
+static std::string formatNanos(uint64_t ns) {
+    char buf[32];
+    if (ns < 1000)
+        std::snprintf(buf, sizeof buf, "%llu ns", static_cast<unsigned long long>(ns));
+    else if (ns < 1000000)
+        std::snprintf(buf, sizeof buf, "%.1f µs", static_cast<double>(ns) / 1e3);
+    else
+        std::snprintf(buf, sizeof buf, "%.1f ms", static_cast<double>(ns) / 1e6);
+    return buf;
+}
+
+// Counts and latencies of every session in this process, one line per
+// intent seen so far
+static std::string statsSummary() {
+    Metrics::Snapshot snap = Metrics::snapshot();
+    uint64_t total = snap.total();
+    if (total == 0) return "📊 No messages answered yet.";
+
+    std::string out = "📊 Messages answered: " + std::to_string(total) + " (all sessions)";
+    for (size_t i = 0; i < Metrics::INTENTS; ++i) {
+        const Metrics::IntentStats& s = snap.intents[i];
+        if (s.count == 0) continue;
+        char share[16];
+        std::snprintf(share, sizeof share, "%.1f%%", 100.0 * static_cast<double>(s.count) /
+                                                     static_cast<double>(total));
+        out.append("\n").append(intentName(static_cast<Intent>(i)))
+           .append(": ").append(std::to_string(s.count))
+           .append(" (").append(share).append(") · p50 ").append(formatNanos(s.percentile(0.50)))
+           .append(" · p99 ").append(formatNanos(s.percentile(0.99)));
+    }
+
+    uint64_t hits = snap[Metrics::CacheEvent::Hit];
+    uint64_t lookups = hits + snap[Metrics::CacheEvent::Miss];
+    if (lookups > 0) {
+        char rate[16];
+        std::snprintf(rate, sizeof rate, "%.1f%%", 100.0 * static_cast<double>(hits) /
+                                                   static_cast<double>(lookups));
+        out.append("\nintent cache: ").append(rate).append(" of ").append(std::to_string(lookups))
+           .append(" lookups hit · ").append(std::to_string(snap[Metrics::CacheEvent::Eviction]))
+           .append(" evictions");
+    }
+    return out;
+}
+
+// ─── Engine ─────────────────────────────────────────────────────
+
+// Commands with a fixed answer, and the flags they raise
+static void commandLine(const KnowledgeBase& kb, Session& session, Response& reply) {
+    std::string& out = session.replyText;
+    switch (reply.command) {
+        case Command::Exit:
+            reply.text = "Goodbye! Thanks for chatting. 👋";
+            reply.flags |= Response::EndSession;
+            break;
+        case Command::Help:
+            reply.text = "Commands: help, calc, joke, fact, time, flip, roll, "
+                         "reverse <text>, count <text>, history, uptime, stats, clear, reload, bye";
+            reply.flags |= Response::ShowHelp;
+            break;
+        case Command::Joke:
+            reply.text = out.assign(kb.randomJoke(session.random));   // the image may be swapped out
+            break;
+        case Command::Fact:
+            reply.text = out.assign(kb.randomFact(session.random));
+            break;
+        case Command::Time:
+            out.assign("🕐 ");
+            Util::appendDateTime(out);
+            reply.text = out;
+            break;
+        case Command::Flip:
+            reply.text = session.random.below(2) ? "Heads! 🪙" : "Tails! 🪙";
+            break;
+        case Command::Roll:
+            out.assign("🎲 You rolled a ").append(1, static_cast<char>('0' + session.random.between(1, 6))).append("!");
+            reply.text = out;
+            break;
+        case Command::Uptime: {
+            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::steady_clock::now() - session.start);
+            out.assign("⏱️  Session uptime: ");
+            Util::appendDuration(out, elapsed);
+            out.append(" | Messages: ").append(std::to_string(session.messageCount));
+            reply.text = out;
+            break;
+        }
+        case Command::Stats:
+            reply.text = out = statsSummary();
+            break;
+        case Command::History:
+            reply.text = out = historySummary(session, reply.historyPage);
+            break;
+        case Command::Clear:
+            reply.text = "Screen cleared! ✨";
+            reply.flags |= Response::ClearScreen;
+            break;
+        case Command::Calc:
+            session.stage = Stage::Calculator;
+            reply.text = "🧮 Calculator Mode!\n"
+                         "Enter an expression like: (42 + 18) * 2, or set r = 4 then pi * r^2\n"
+                         "Operators: + - * / % ^   Functions: sqrt pow sin cos tan log exp abs min max\n"
+                         "Type 'done' to exit calculator.";
+            break;
+        case Command::Reload:
+            reply.text = "🔄 Reloading the knowledge base in the background.";
+            reply.flags |= Response::Reload;
+            break;
+        case Command::None:
+            break;
+    }
+}
+
+static void resolve(const KnowledgeBase& kb, Session& session, std::string_view input, Response& reply) {
+    switch (session.stage) {
+        case Stage::Welcome:
+        case Stage::Tour:
+            welcomeLine(session, input, reply);
+            return;
+        case Stage::Calculator:
+            calculatorLine(session, input, reply);
+            return;
+        case Stage::Chat:
+            break;
+    }
+
+    ++session.messageCount;
+    if (session.keepHistory) session.history.push(input);
+
+    // Built-in commands — one perfect-hash probe (see commands.hpp)
+    reply.command = Commands::lookup(input);
+    if (reply.command == Command::None && parseHistoryPage(input, reply.historyPage))
+        reply.command = Command::History;
+    if (reply.command != Command::None) {
+        reply.intent = Intent::Command;
+        commandLine(kb, session, reply);
+        return;
+    }
+
+    // Parameterized commands
+    std::string& out = session.replyText;
+    if (Util::startsWith(input, "reverse ")) {
+        std::string_view text = input.substr(8);
+        reply.intent = Intent::Reverse;
+        out.assign("🔄 \"");
+        Utf8::appendReversed(out, text);
+        out.append("\"");
+        reply.text = out;
+        return;
+    }
+    if (Util::startsWith(input, "count ")) {
+        reply.intent = Intent::Count;
+        out.assign("📝 Word count: ").append(std::to_string(Utf8::countWords(input.substr(6))));
+        reply.text = out;
+        return;
+    }
+
+    // Exact or alias match (one probe), then partial match — the
+    // longest known key contained in the input — then the closest key
+    // within a few typos, then word-level retrieval; the last three
+    // are memoized
+    KnowledgeBase::Entry entry = kb.find(input);
+    if (entry.found)
+        reply.intent = entry.alias ? Intent::Alias : Intent::Exact;
+    else
+        entry = kb.findNearest(input, session.fuzzyDistance, reply.intent);
+#ifdef DEBUG
+    Util::markLookup();
+#endif
+    if (entry.found) {
+        // Copied: the caller may unpin this version of the knowledge
+        // base before it is done with the reply
+        reply.key  = session.replyKey.assign(entry.key);
+        reply.text = out.assign(entry.text);
+        return;
+    }
+
+    // No match
+    reply.text = "Hmm, I don't quite understand that. 🤔\n"
+                 "Try 'help' to see what I can do, or just say hi!";
+}
+
+Response respond(const KnowledgeBase& kb, Session& session, std::string_view input) {
+    uint64_t start = Metrics::now();
+    Response reply;
+    resolve(kb, session, input, reply);
+    Metrics::record(reply.intent, start);
+    return reply;
+}
+
+HistoryPage historyPage(Session& session, size_t page) {
+    HistoryPage result;
+    result.page  = page;
+    result.total = session.history.total();
+    result.pages = (result.total + HISTORY_PAGE_SIZE - 1) / HISTORY_PAGE_SIZE;
+    if (page == 0 || page > result.pages) return result;
+
+    size_t last  = result.total - (page - 1) * HISTORY_PAGE_SIZE;
+    result.first = last > HISTORY_PAGE_SIZE ? last - HISTORY_PAGE_SIZE : 0;
+    const size_t available = session.history.firstAvailable();
+    result.first = std::max(result.first, available);
+    result.available = last > available && session.history.get(result.first, last, result.messages);
+    return result;
+}
+
+std::string historySummary(Session& session, size_t page) {
+    if (!session.keepHistory) return "History is not kept in pipe mode.";
+    if (session.history.empty()) return "No conversation history yet!";
+
+    HistoryPage p = historyPage(session, page);
+    if (page > p.pages)
+        return "There " + std::string(p.pages == 1 ? "is only 1 page" : "are only " +
+               std::to_string(p.pages) + " pages") + " of history.";
+    if (!p.available)
+        return "Messages before #" + std::to_string(session.history.firstAvailable() + 1) +
+               (session.history.hasLog() ? " were not logged."
+                                         : " are no longer kept. Start with --history-log FILE to page further back.");
+
+    std::string out = "Messages " + std::to_string(p.first + 1) + "-" +
+                      std::to_string(p.first + p.messages.size()) + " of " +
+                      std::to_string(p.total) + ":";
+    for (size_t i = 0; i < p.messages.size(); ++i) {
+        out += i == 0 ? " " : " | ";
+        out += p.messages[i];
+    }
+    if (p.page < p.pages) out += " (history " + std::to_string(p.page + 1) + " for older)";
+    return out;
+}
+
+void appendPlainLine(std::string& out, const Response& response) {
+    std::string_view text = response.text;
+    size_t begin = 0;
+    while (true) {
+        size_t end = text.find('\n', begin);
+        out.append(text.substr(begin, end == std::string_view::npos ? std::string_view::npos : end - begin));
+        if (end == std::string_view::npos) break;
+        out += ' ';
+        begin = end + 1;
+    }
+    out += '\n';
+}
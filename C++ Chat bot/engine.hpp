@@ -0,0 +1,187 @@
+/**
+ *  engine.hpp — Chat engine: shared knowledge tables, per-session state
+ *
+ *  A KnowledgeBase is built once and is read-only afterwards, so any
+ *  number of sessions (and threads) can share one instance. Everything
+ *  that belongs to a single conversation lives in a small Session.
+ *  respond() resolves one message without any terminal I/O.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "commands.hpp"
+#include "expr.hpp"
+#include "fuzzy.hpp"
+#include "history.hpp"
+#include "intent_cache.hpp"
+#include "kb_image.hpp"
+#include "mapped_file.hpp"
+#include "random.hpp"
+#include "util.hpp"
+
+// ─── Replies ────────────────────────────────────────────────────
+// How a message was resolved
+enum class Intent : uint8_t {
+    Command,      // built-in command, see Response::command
+    Reverse,
+    Count,
+    Alias,
+    Exact,
+    Partial,
+    Fuzzy,        // closest key within the typo allowance
+    Search,       // key sharing the most informative words (BM25)
+    Miss,
+    Welcome,      // answer to a welcome question
+    Calculator    // line handled in calculator mode
+};
+
+std::string_view intentName(Intent intent);
+
+// Result of one message: plain text without terminal formatting.
+// Multi-line replies separate their lines with '\n'. The views point at
+// static text or into the session, never into the knowledge base, and
+// stay valid until the session's next respond() or reset().
+struct Response {
+    // What a front end should do besides showing the text
+    enum Flag : uint8_t {
+        EndSession  = 1 << 0,   // "bye", or a declined welcome
+        ClearScreen = 1 << 1,
+        ShowHelp    = 1 << 2,   // the command list goes with this reply
+        Reload      = 1 << 3,   // the caller should reload the knowledge base
+    };
+
+    Intent           intent  = Intent::Miss;
+    Command          command = Command::None;
+    uint8_t          flags   = 0;
+    std::string_view key;                    // matched knowledge key, if any
+    std::string_view text;
+    size_t           historyPage = 1;        // Command::History: 1 = newest messages
+
+    bool has(Flag flag) const { return flags & flag; }
+};
+
+// ─── Session ────────────────────────────────────────────────────
+
+// Where a conversation stands. A dialogue is a state machine advanced
+// by one event — a message arrived — so no front end ever blocks inside
+// a mode, and one thread can interleave any number of sessions, each
+// in its own stage.
+enum class Stage : uint8_t {
+    Welcome,      // asked whether to start chatting
+    Tour,         // asked whether to see the commands
+    Chat,
+    Calculator
+};
+
+// Per-conversation state; everything else is shared.
+struct Session {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t messageCount   = 0;
+    Stage  stage          = Stage::Chat;   // interactive sessions start at Welcome
+    bool   keepHistory    = true;
+    unsigned fuzzyDistance = Fuzzy::DEFAULT_DISTANCE;   // max typos; 0 disables
+    Random random{Util::randomSeed()};  // jokes, facts, flips, rolls; reseed to replay
+    Expr::Variables variables;          // calculator variables, plus `ans`
+    History history;                    // last messages in RAM, older ones in the log
+    std::string replyKey, replyText;    // back the last Response; reused, so steady-state replies do not allocate
+
+    // Starts over as a new session with a fresh seed, reusing the
+    // buffers this one allocated
+    void reset();
+};
+
+// ─── Knowledge Base ─────────────────────────────────────────────
+// Responses, aliases, jokes and facts as one compiled image (see
+// kb_image.hpp): either the built-in content, compiled into the binary
+// from knowledge.txt, or a kbc-compiled file mapped with load().
+// Immutable once loaded, apart from its intent cache, which is safe to
+// share.
+class KnowledgeBase {
+public:
+    // Built-in content; `cacheEntries` sizes the intent cache (0 = off)
+    explicit KnowledgeBase(size_t cacheEntries = IntentCache::DEFAULT_ENTRIES);
+
+    KnowledgeBase(const KnowledgeBase&) = delete;
+    KnowledgeBase& operator=(const KnowledgeBase&) = delete;
+
+    // Switches to a compiled image file, answered straight from the
+    // mapping. On failure the current content is kept and `error` says why.
+    bool load(const std::string& path, std::string& error);
+
+    using Entry = Kb::Image::Lookup;
+
+    // Exact or alias match — one hash probe
+    Entry find(std::string_view input) const { return image_.find(input); }
+
+    // Longest known key contained in the input
+    Entry findPartial(std::string_view input) const { return image_.findPartial(input); }
+
+    // Closest key within `maxDistance` edits, scaled down for short input
+    Entry findFuzzy(std::string_view input, unsigned maxDistance) const {
+        return image_.findFuzzy(input, maxDistance);
+    }
+
+    // Key sharing the most informative words with a free-form question
+    Entry findRelated(std::string_view input) const { return image_.findRelated(input); }
+
+    // For input without an exact key: findPartial(), findFuzzy(), then
+    // findRelated(), remembered in the intent cache. `intent` becomes
+    // Partial, Fuzzy, Search or Miss.
+    Entry findNearest(std::string_view input, unsigned maxDistance, Intent& intent) const;
+
+    size_t cacheCapacity() const { return cache_.capacity(); }
+
+    std::string_view randomJoke(Random& random) const;
+    std::string_view randomFact(Random& random) const;
+
+    const Kb::Image& image() const { return image_; }
+
+private:
+    MappedFile          mapped_;   // image loaded from disk; unused for the built-in one
+    Kb::Image           image_;
+    mutable IntentCache cache_;
+};
+
+// ─── Engine ─────────────────────────────────────────────────────
+
+// Resolves one normalized message. Updates `session` (history, stage);
+// never prints. A reload is only requested through Response::Reload:
+// the caller owns the KnowledgeStore. Allocation-free once the
+// session's buffers have grown, apart from stats, history pages and
+// calculator errors.
+// Every call is counted and timed in the calling thread's metrics
+// shard (see metrics.hpp).
+Response respond(const KnowledgeBase& kb, Session& session, std::string_view input);
+
+// The question a session in a welcome stage is waiting to have
+// answered; empty in the other stages
+std::string_view pendingQuestion(const Session& session);
+
+// ─── History Pages ──────────────────────────────────────────────
+
+inline constexpr size_t HISTORY_PAGE_SIZE = 20;
+
+struct HistoryPage {
+    size_t page  = 1;
+    size_t pages = 0;
+    size_t first = 0;                        // message number of messages[0], from 0;
+                                             // a page reaching back past firstAvailable() starts there
+    size_t total = 0;
+    bool   available = true;                 // false: older than RAM and the log
+    std::vector<std::string_view> messages;  // valid until the next message
+};
+
+// Page 1 holds the newest HISTORY_PAGE_SIZE messages, page 2 the ones before
+HistoryPage historyPage(Session& session, size_t page);
+
+// One-line rendering of a history page for plain-text front ends
+std::string historySummary(Session& session, size_t page = 1);
+
+// Appends `response` as exactly one line: multi-line replies are joined
+void appendPlainLine(std::string& out, const Response& response);
@@ -0,0 +1,487 @@
+/**
+ *  expr.cpp — Tokenizer, Pratt compiler and bytecode interpreters
+ */
+
+#include "expr.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+namespace Expr {
+
+    namespace {
+
+        constexpr size_t MAX_NESTING = 128;   // parser recursion limit
+        constexpr size_t BLOCK       = 256;   // rows per batch step
+
+        struct Function {
+            std::string_view name;
+            Op               op;
+            uint8_t          arity;
+        };
+
+        constexpr Function FUNCTIONS[] = {
+            {"sqrt", Op::Sqrt, 1}, {"abs", Op::Abs, 1}, {"exp", Op::Exp, 1},
+            {"log", Op::Log, 1},   {"ln", Op::Log, 1},  {"sin", Op::Sin, 1},
+            {"cos", Op::Cos, 1},   {"tan", Op::Tan, 1}, {"floor", Op::Floor, 1},
+            {"ceil", Op::Ceil, 1}, {"round", Op::Round, 1},
+            {"pow", Op::Pow, 2},   {"min", Op::Min, 2}, {"max", Op::Max, 2},
+        };
+
+        struct Constant {
+            std::string_view name;
+            double           value;
+        };
+
+        constexpr Constant CONSTANTS[] = {
+            {"pi", 3.14159265358979323846},
+            {"e",  2.71828182845904523536},
+        };
+
+        bool isNameStart(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+        bool isDigit(char c)     { return c >= '0' && c <= '9'; }
+        bool isNameChar(char c)  { return isNameStart(c) || isDigit(c); }
+
+        // ─── Tokenizer ──────────────────────────────────────────
+
+        enum class Tok : uint8_t {
+            End, Number, Name, Plus, Minus, Star, Slash, Percent, Caret,
+            LParen, RParen, Comma, Assign, Invalid
+        };
+
+        struct Token {
+            Tok              kind = Tok::End;
+            std::string_view text;
+            double           number = 0;
+        };
+
+        class Lexer {
+        public:
+            explicit Lexer(std::string_view s) : s_(s) {}
+
+            Token next() {
+                while (pos_ < s_.size() && (s_[pos_] == ' ' || s_[pos_] == '\t')) ++pos_;
+                Token t;
+                if (pos_ >= s_.size()) return t;
+
+                size_t begin = pos_;
+                char c = s_[pos_];
+                if (isDigit(c) || c == '.') {
+                    auto [end, ec] = std::from_chars(s_.data() + pos_, s_.data() + s_.size(), t.number);
+                    if (ec != std::errc()) {
+                        t.kind = Tok::Invalid;
+                        t.text = s_.substr(pos_, 1);
+                        ++pos_;
+                        return t;
+                    }
+                    pos_ = static_cast<size_t>(end - s_.data());
+                    t.kind = Tok::Number;
+                } else if (c == 'x' && afterOperand_ &&
+                           (pos_ + 1 >= s_.size() || !isNameStart(s_[pos_ + 1]))) {
+                    ++pos_;                    // "6 x 7" and "6x7" multiply
+                    t.kind = Tok::Star;
+                } else if (isNameStart(c)) {
+                    while (pos_ < s_.size() && isNameChar(s_[pos_])) ++pos_;
+                    t.kind = Tok::Name;
+                } else {
+                    ++pos_;
+                    switch (c) {
+                        case '+': t.kind = Tok::Plus;    break;
+                        case '-': t.kind = Tok::Minus;   break;
+                        case '*': t.kind = Tok::Star;    break;
+                        case '/': t.kind = Tok::Slash;   break;
+                        case '%': t.kind = Tok::Percent; break;
+                        case '^': t.kind = Tok::Caret;   break;
+                        case '(': t.kind = Tok::LParen;  break;
+                        case ')': t.kind = Tok::RParen;  break;
+                        case ',': t.kind = Tok::Comma;   break;
+                        case '=': t.kind = Tok::Assign;  break;
+                        default:
+                            // Keep a multi-byte UTF-8 character whole in the message
+                            while (pos_ < s_.size() && (static_cast<unsigned char>(s_[pos_]) & 0xC0) == 0x80) ++pos_;
+                            t.kind = Tok::Invalid;
+                    }
+                }
+                t.text = s_.substr(begin, pos_ - begin);
+                afterOperand_ = t.kind == Tok::Number || t.kind == Tok::Name || t.kind == Tok::RParen;
+                return t;
+            }
+
+        private:
+            std::string_view s_;
+            size_t           pos_ = 0;
+            bool             afterOperand_ = false;
+        };
+
+        // ─── Compiler ───────────────────────────────────────────
+
+        struct Infix {
+            int lbp, rbp;
+            Op  op;
+        };
+
+        bool infixFor(Tok kind, Infix& out) {
+            switch (kind) {
+                case Tok::Plus:    out = {10, 11, Op::Add}; return true;
+                case Tok::Minus:   out = {10, 11, Op::Sub}; return true;
+                case Tok::Star:    out = {20, 21, Op::Mul}; return true;
+                case Tok::Slash:   out = {20, 21, Op::Div}; return true;
+                case Tok::Percent: out = {20, 21, Op::Mod}; return true;
+                case Tok::Caret:   out = {30, 29, Op::Pow}; return true;   // right-associative
+                default:           return false;
+            }
+        }
+
+        constexpr int PREFIX_BP = 25;   // below ^, above * and /
+
+        class Compiler {
+        public:
+            Compiler(std::string_view source, Program& program, std::string& error)
+                : lexer_(source), program_(program), error_(error) {}
+
+            bool run() {
+                program_ = Program{};
+                advance();
+
+                // Statement level: `name = expr`
+                if (tok_.kind == Tok::Name) {
+                    Lexer peek = lexer_;
+                    if (peek.next().kind == Tok::Assign) {
+                        for (const auto& c : CONSTANTS)
+                            if (tok_.text == c.name) return fail("Can't assign to the constant '" + std::string(c.name) + "'");
+                        if (tok_.text.size() > MAX_NAME_BYTES)
+                            return fail("Variable names are at most " + std::to_string(MAX_NAME_BYTES) + " characters");
+                        program_.assignTo = std::string(tok_.text);
+                        advance();
+                        advance();
+                    }
+                }
+
+                if (tok_.kind == Tok::End) return fail("Enter an expression");
+                if (!expression(0)) return false;
+                if (tok_.kind != Tok::End) return unexpected();
+                return true;
+            }
+
+        private:
+            Lexer       lexer_;
+            Token       tok_;
+            Program&    program_;
+            std::string& error_;
+            size_t      depth_   = 0;    // current stack depth
+            size_t      nesting_ = 0;
+
+            void advance() { tok_ = lexer_.next(); }
+
+            bool fail(std::string message) {
+                error_ = std::move(message);
+                return false;
+            }
+
+            bool unexpected() {
+                if (tok_.kind == Tok::End) return fail("The expression ends too early");
+                return fail("Unexpected '" + std::string(tok_.text) + "'");
+            }
+
+            bool emit(Op op, size_t arg = 0) {
+                if (arg > UINT16_MAX) return fail("Expression is too long");
+                program_.code.push_back({op, static_cast<uint16_t>(arg)});
+                return true;
+            }
+
+            bool push(Op op, size_t arg) {
+                if (++depth_ > MAX_STACK) return fail("Expression is too complex");
+                program_.stackDepth = std::max(program_.stackDepth, depth_);
+                return emit(op, arg);
+            }
+
+            bool pushConst(double value) {
+                program_.consts.push_back(value);
+                return push(Op::Const, program_.consts.size() - 1);
+            }
+
+            bool pushVariable(std::string_view name) {
+                auto& names = program_.names;
+                auto it = std::find(names.begin(), names.end(), name);
+                if (it == names.end()) it = names.insert(names.end(), std::string(name));
+                return push(Op::Load, static_cast<size_t>(it - names.begin()));
+            }
+
+            bool expect(Tok kind, const char* what) {
+                if (tok_.kind != kind) {
+                    if (tok_.kind == Tok::End) return fail(std::string("Missing ") + what);
+                    return unexpected();
+                }
+                advance();
+                return true;
+            }
+
+            bool expression(int minBp) {
+                if (++nesting_ > MAX_NESTING) return fail("Expression is nested too deeply");
+                if (!prefix()) return false;
+
+                Infix infix;
+                while (infixFor(tok_.kind, infix) && infix.lbp >= minBp) {
+                    advance();
+                    if (!expression(infix.rbp) || !emit(infix.op)) return false;
+                    --depth_;
+                }
+                --nesting_;
+                return true;
+            }
+
+            bool prefix() {
+                Token t = tok_;
+                switch (t.kind) {
+                    case Tok::Number:
+                        advance();
+                        return pushConst(t.number);
+                    case Tok::Minus:
+                        advance();
+                        return expression(PREFIX_BP) && emit(Op::Neg);
+                    case Tok::Plus:
+                        advance();
+                        return expression(PREFIX_BP);
+                    case Tok::LParen:
+                        advance();
+                        return expression(0) && expect(Tok::RParen, "')'");
+                    case Tok::Name:
+                        advance();
+                        if (tok_.kind == Tok::LParen) return call(t.text);
+                        for (const auto& c : CONSTANTS)
+                            if (t.text == c.name) return pushConst(c.value);
+                        return pushVariable(t.text);
+                    default:
+                        return unexpected();
+                }
+            }
+
+            bool call(std::string_view name) {
+                const Function* fn = nullptr;
+                for (const auto& f : FUNCTIONS)
+                    if (f.name == name) fn = &f;
+                if (!fn) return fail("Unknown function '" + std::string(name) + "'");
+
+                advance();   // '('
+                size_t args = 0;
+                if (tok_.kind != Tok::RParen) {
+                    while (true) {
+                        if (!expression(0)) return false;
+                        ++args;
+                        if (tok_.kind != Tok::Comma) break;
+                        advance();
+                    }
+                }
+                if (!expect(Tok::RParen, "')'")) return false;
+                if (args != fn->arity)
+                    return fail(std::string(name) + " takes " + std::to_string(fn->arity) +
+                                (fn->arity == 1 ? " argument" : " arguments"));
+
+                depth_ -= args - 1;   // arguments in, one result out
+                return emit(fn->op);
+            }
+        };
+
+        // ─── Interpreters ───────────────────────────────────────
+
+        double apply(Op op, double a) {
+            switch (op) {
+                case Op::Neg:   return -a;
+                case Op::Sqrt:  return std::sqrt(a);
+                case Op::Abs:   return std::fabs(a);
+                case Op::Exp:   return std::exp(a);
+                case Op::Log:   return std::log(a);
+                case Op::Sin:   return std::sin(a);
+                case Op::Cos:   return std::cos(a);
+                case Op::Tan:   return std::tan(a);
+                case Op::Floor: return std::floor(a);
+                case Op::Ceil:  return std::ceil(a);
+                case Op::Round: return std::round(a);
+                default:        return a;
+            }
+        }
+
+        double apply(Op op, double a, double b) {
+            switch (op) {
+                case Op::Add: return a + b;
+                case Op::Sub: return a - b;
+                case Op::Mul: return a * b;
+                case Op::Div: return a / b;
+                case Op::Mod: return std::fmod(a, b);
+                case Op::Pow: return std::pow(a, b);
+                case Op::Min: return std::min(a, b);
+                case Op::Max: return std::max(a, b);
+                default:      return a;
+            }
+        }
+
+        bool isBinary(Op op) { return op >= Op::Add && op <= Op::Max; }
+
+        // `a[i] = f(a[i], b[i])` as separate loops per operator, so each
+        // one is a straight-line kernel the vectorizer can take
+        void binaryBlock(Op op, double* a, const double* b, size_t n) {
+            switch (op) {
+                case Op::Add: for (size_t i = 0; i < n; ++i) a[i] += b[i]; break;
+                case Op::Sub: for (size_t i = 0; i < n; ++i) a[i] -= b[i]; break;
+                case Op::Mul: for (size_t i = 0; i < n; ++i) a[i] *= b[i]; break;
+                case Op::Div: for (size_t i = 0; i < n; ++i) a[i] /= b[i]; break;
+                case Op::Min: for (size_t i = 0; i < n; ++i) a[i] = b[i] < a[i] ? b[i] : a[i]; break;
+                case Op::Max: for (size_t i = 0; i < n; ++i) a[i] = b[i] > a[i] ? b[i] : a[i]; break;
+                default:      for (size_t i = 0; i < n; ++i) a[i] = apply(op, a[i], b[i]); break;
+            }
+        }
+
+        void unaryBlock(Op op, double* a, size_t n) {
+            switch (op) {
+                case Op::Neg:  for (size_t i = 0; i < n; ++i) a[i] = -a[i]; break;
+                case Op::Sqrt: for (size_t i = 0; i < n; ++i) a[i] = std::sqrt(a[i]); break;
+                case Op::Abs:  for (size_t i = 0; i < n; ++i) a[i] = std::fabs(a[i]); break;
+                default:       for (size_t i = 0; i < n; ++i) a[i] = apply(op, a[i]); break;
+            }
+        }
+    }
+
+    bool compile(std::string_view source, Program& program, std::string& error) {
+        return Compiler(source, program, error).run();
+    }
+
+    Result evaluate(const Program& program, const Variables& variables) {
+        Result result;
+        double stack[MAX_STACK];
+        size_t sp = 0;
+
+        for (const Instr& in : program.code) {
+            switch (in.op) {
+                case Op::Const:
+                    stack[sp++] = program.consts[in.arg];
+                    break;
+                case Op::Load: {
+                    auto it = variables.find(program.names[in.arg]);
+                    if (it == variables.end()) {
+                        result.status = Status::UnknownVariable;
+                        result.detail = program.names[in.arg];
+                        return result;
+                    }
+                    stack[sp++] = it->second;
+                    break;
+                }
+                case Op::Div:
+                case Op::Mod:
+                    if (stack[sp - 1] == 0) {
+                        result.status = Status::DivisionByZero;
+                        return result;
+                    }
+                    [[fallthrough]];
+                default:
+                    if (isBinary(in.op)) {
+                        --sp;
+                        stack[sp - 1] = apply(in.op, stack[sp - 1], stack[sp]);
+                    } else {
+                        stack[sp - 1] = apply(in.op, stack[sp - 1]);
+                    }
+            }
+        }
+
+        result.value = stack[0];
+        if (!std::isfinite(result.value)) result.status = Status::NotFinite;
+        return result;
+    }
+
+    bool evaluateBatch(const Program& program, const std::vector<Column>& columns,
+                       const Variables& scalars, size_t count, double* out, std::string& error) {
+        // Bind every variable once: a column, or a scalar broadcast to all rows
+        struct Binding {
+            const double* column = nullptr;
+            double        scalar = 0;
+        };
+        std::vector<Binding> bindings(program.names.size());
+        for (size_t i = 0; i < program.names.size(); ++i) {
+            const std::string& name = program.names[i];
+            auto col = std::find_if(columns.begin(), columns.end(),
+                                    [&name](const Column& c) { return c.name == name; });
+            if (col != columns.end()) {
+                bindings[i].column = col->values;
+                continue;
+            }
+            auto it = scalars.find(name);
+            if (it == scalars.end()) {
+                error = "Unknown variable '" + name + "'";
+                return false;
+            }
+            bindings[i].scalar = it->second;
+        }
+
+        std::vector<double> stack(std::max<size_t>(program.stackDepth, 1) * BLOCK);
+        for (size_t base = 0; base < count; base += BLOCK) {
+            const size_t n = std::min(BLOCK, count - base);
+            size_t sp = 0;
+            for (const Instr& in : program.code) {
+                double* top = stack.data() + sp * BLOCK;
+                switch (in.op) {
+                    case Op::Const:
+                        std::fill_n(top, n, program.consts[in.arg]);
+                        ++sp;
+                        break;
+                    case Op::Load: {
+                        const Binding& b = bindings[in.arg];
+                        if (b.column)
+                            std::copy_n(b.column + base, n, top);
+                        else
+                            std::fill_n(top, n, b.scalar);
+                        ++sp;
+                        break;
+                    }
+                    default:
+                        if (isBinary(in.op)) {
+                            --sp;
+                            binaryBlock(in.op, top - 2 * BLOCK, top - BLOCK, n);
+                        } else {
+                            unaryBlock(in.op, top - BLOCK, n);
+                        }
+                }
+            }
+            std::copy_n(stack.data(), n, out + base);
+        }
+        return true;
+    }
+
+    std::string format(double value) {
+        if (value == 0) return "0";   // also -0
+
+        char buf[64];
+        double magnitude = std::fabs(value);
+        if (magnitude >= 1e15 || magnitude < 1e-4) {
+            auto res = std::to_chars(buf, buf + sizeof buf, value, std::chars_format::general, 10);
+            return std::string(buf, res.ptr);
+        }
+
+        auto res = std::to_chars(buf, buf + sizeof buf, value, std::chars_format::fixed, 4);
+        char* end = res.ptr;
+        while (end[-1] == '0') --end;   // fixed output always has a '.'
+        if (end[-1] == '.') --end;
+        std::string text(buf, end);
+        return text == "-0" ? "0" : text;
+    }
+
+    // ─── Cache ──────────────────────────────────────────────────
+
+    const Program* Cache::get(std::string_view source, std::string& error) {
+        auto hit = index_.find(source);
+        if (hit != index_.end()) {
+            order_.splice(order_.begin(), order_, hit->second);
+            return &hit->second->second;
+        }
+
+        Program program;
+        if (!compile(source, program, error)) return nullptr;
+
+        order_.emplace_front(std::string(source), std::move(program));
+        index_.emplace(order_.front().first, order_.begin());
+        if (index_.size() > capacity_) {
+            index_.erase(order_.back().first);
+            order_.pop_back();
+        }
+        return &order_.front().second;
+    }
+}
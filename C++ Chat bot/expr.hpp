@@ -0,0 +1,120 @@
+/**
+ *  expr.hpp — Calculator expression engine
+ *
+ *  Source text is tokenized and compiled by a Pratt parser straight to
+ *  compact stack-machine bytecode; a Program is immutable and can be
+ *  evaluated any number of times, for one set of variables or for whole
+ *  arrays of inputs at once.
+ *
+ *  Grammar, loosest binding first:
+ *
+ *      name = expr                    assignment (statement level only)
+ *      a + b    a - b
+ *      a * b    a / b    a % b        `x` between operands also multiplies
+ *      -a       +a
+ *      a ^ b                          right-associative; -2^2 is -4
+ *      f(args)  (expr)  number  name  pi  e
+ *
+ *  Functions: sqrt abs exp log sin cos tan floor ceil round (one
+ *  argument), pow min max (two).
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Expr {
+
+    enum class Op : uint8_t {
+        Const,      // push consts[arg]
+        Load,       // push variable names[arg]
+        Add, Sub, Mul, Div, Mod, Pow, Min, Max,
+        Neg, Sqrt, Abs, Exp, Log, Sin, Cos, Tan, Floor, Ceil, Round
+    };
+
+    struct Instr {
+        Op       op;
+        uint16_t arg;
+    };
+
+    inline constexpr size_t MAX_STACK = 64;
+
+    // Bounds on what one session can store (see engine.cpp), so no
+    // client can grow a server without limit
+    inline constexpr size_t MAX_NAME_BYTES = 32;   // assigned variable names
+    inline constexpr size_t MAX_VARIABLES  = 64;   // per session, `ans` included
+
+    struct Program {
+        std::vector<Instr>       code;
+        std::vector<double>      consts;
+        std::vector<std::string> names;       // variables read, by Load index
+        std::string              assignTo;    // "" unless `name = expr`
+        size_t                   stackDepth = 0;
+    };
+
+    // Compiles one expression or assignment; on failure returns false
+    // and describes the problem in `error`
+    bool compile(std::string_view source, Program& program, std::string& error);
+
+    // ── Evaluation ──────────────────────────────────────────────
+
+    using Variables = std::unordered_map<std::string, double>;
+
+    enum class Status : uint8_t { Ok, UnknownVariable, DivisionByZero, NotFinite };
+
+    struct Result {
+        Status      status = Status::Ok;
+        double      value  = 0;
+        std::string detail;    // the unknown variable's name
+    };
+
+    // Scalar evaluation. Division by zero, and results that are not a
+    // finite real number (sqrt(-1), 10^999), are reported as a status.
+    Result evaluate(const Program& program, const Variables& variables);
+
+    // One input array per variable
+    struct Column {
+        std::string_view name;
+        const double*    values;
+    };
+
+    // Evaluates `program` for `count` rows: row i binds each column's
+    // values[i], other variables come from `scalars`. Runs a block of
+    // rows per instruction in plain loops the compiler can vectorize;
+    // results follow IEEE rules (x/0 is inf, NaN propagates). Returns
+    // false only for a variable that is bound nowhere.
+    bool evaluateBatch(const Program& program, const std::vector<Column>& columns,
+                       const Variables& scalars, size_t count, double* out, std::string& error);
+
+    // Shortest readable form: up to four decimals, trailing zeros dropped
+    // ("60", "3.3333"); scientific notation for very large or small values
+    std::string format(double value);
+
+    // ── Compiled-expression cache ───────────────────────────────
+
+    // Least-recently-used cache keyed by source text. Not thread-safe:
+    // keep one per thread.
+    class Cache {
+    public:
+        explicit Cache(size_t capacity = 64) : capacity_(capacity) {}
+
+        // Program for `source`, compiled on a miss; nullptr on a syntax
+        // error. The pointer is valid until the next get().
+        const Program* get(std::string_view source, std::string& error);
+
+        size_t size() const { return index_.size(); }
+
+    private:
+        using Entry = std::pair<std::string, Program>;
+
+        size_t                                                          capacity_;
+        std::list<Entry>                                                order_;   // most recent first
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+    };
+}
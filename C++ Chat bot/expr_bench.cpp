@@ -0,0 +1,123 @@
+/**
+ *  expr_bench.cpp — Calculator expression engine microbenchmark
+ *
+ *  1. One calculator line, end to end: the original istringstream parse
+ *     plus ostringstream formatting, against a cached compiled Program
+ *     plus std::to_chars formatting.
+ *  2. One compiled expression over a million rows: a scalar evaluate()
+ *     per row against a single evaluateBatch() call.
+ *
+ *  Build & run:  make bench-expr
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "expr.hpp"
+
+static volatile size_t g_sink;  // keeps results observable
+
+// The calculator as it was: `<number> <op> <number>` only
+static std::string legacyCalculate(const std::string& line) {
+    std::istringstream iss(line);
+    double a, b;
+    char op;
+    if (!(iss >> a >> op >> b)) return "error";
+
+    double result = 0;
+    switch (op) {
+        case '+': result = a + b; break;
+        case '-': result = a - b; break;
+        case '*': case 'x': result = a * b; break;
+        case '/': result = a / b; break;
+        default: return "error";
+    }
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(4) << a << " " << op << " " << b << " = " << result;
+    std::string res = oss.str();
+    res.erase(res.find_last_not_of('0') + 1, std::string::npos);
+    if (res.back() == '.') res.pop_back();
+    return res;
+}
+
+static std::string compiledCalculate(Expr::Cache& cache, const Expr::Variables& vars, const std::string& line) {
+    std::string error;
+    const Expr::Program* program = cache.get(line, error);
+    if (!program) return "error";
+    return line + " = " + Expr::format(Expr::evaluate(*program, vars).value);
+}
+
+template <typename Fn>
+static double nsPer(size_t items, Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(items);
+}
+
+int main() {
+    // ── Calculator lines ────────────────────────────────────────
+    const std::vector<std::string> lines = {
+        "42 + 18", "10 / 3", "7 x 6", "1000 - 0.5", "3.14159 * 2", "99 / 9",
+    };
+    const int rounds = 200000;
+    Expr::Cache cache;
+    Expr::Variables vars;
+
+    double legacy = nsPer(lines.size() * rounds, [&] {
+        size_t sink = 0;
+        for (int r = 0; r < rounds; ++r)
+            for (const auto& line : lines) sink += legacyCalculate(line).size();
+        g_sink = sink;
+    });
+    double compiled = nsPer(lines.size() * rounds, [&] {
+        size_t sink = 0;
+        for (int r = 0; r < rounds; ++r)
+            for (const auto& line : lines) sink += compiledCalculate(cache, vars, line).size();
+        g_sink = sink;
+    });
+
+    std::printf("calculator line (%zu lines x %d rounds)\n", lines.size(), rounds);
+    std::printf("  istringstream + ostringstream : %7.1f ns/line\n", legacy);
+    std::printf("  cached bytecode + to_chars    : %7.1f ns/line\n", compiled);
+    std::printf("  speedup                       : %7.2fx\n\n", legacy / compiled);
+
+    // ── Batch evaluation ────────────────────────────────────────
+    const size_t rows = 1 << 20;
+    std::vector<double> a(rows), b(rows), out(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        a[i] = static_cast<double>(i % 1000);
+        b[i] = static_cast<double>(i % 37) * 0.5;
+    }
+    Expr::Program program;
+    std::string error;
+    Expr::compile("(a * a + b * b) / 2 - a * k", program, error);
+    Expr::Variables scalars = {{"k", 3}};
+
+    double scalar = nsPer(rows, [&] {
+        Expr::Variables row = scalars;
+        for (size_t i = 0; i < rows; ++i) {
+            row["a"] = a[i];
+            row["b"] = b[i];
+            out[i] = Expr::evaluate(program, row).value;
+        }
+    });
+    double check = out[rows - 1];
+    double batch = nsPer(rows, [&] {
+        Expr::evaluateBatch(program, {{"a", a.data()}, {"b", b.data()}}, scalars, rows, out.data(), error);
+    });
+    if (out[rows - 1] != check) {
+        std::fprintf(stderr, "batch and scalar results differ\n");
+        return 1;
+    }
+
+    std::printf("expression over %zu rows: %s\n", rows, "(a * a + b * b) / 2 - a * k");
+    std::printf("  evaluate() per row : %7.2f ns/row\n", scalar);
+    std::printf("  evaluateBatch()    : %7.2f ns/row\n", batch);
+    std::printf("  speedup            : %7.2fx\n", scalar / batch);
+    return 0;
+}
@@ -0,0 +1,53 @@
+/**
+ *  fuzzy.cpp — Bit-parallel edit distance
+ */
+
+#include "fuzzy.hpp"
+
+namespace Fuzzy {
+
+    bool Pattern::assign(std::string_view pattern) {
+        for (size_t i = 0; i < length_; ++i) peq_[chars_[i]] = 0;
+        length_ = 0;
+        if (pattern.empty() || pattern.size() > MAX_PATTERN) return false;
+
+        for (size_t i = 0; i < pattern.size(); ++i) {
+            auto c = static_cast<unsigned char>(pattern[i]);
+            chars_[i] = c;
+            peq_[c] |= uint64_t{1} << i;
+        }
+        length_ = pattern.size();
+        return true;
+    }
+
+    unsigned Pattern::distance(std::string_view text, unsigned maxDistance) const {
+        if (length_ == 0) return static_cast<unsigned>(text.size());
+
+        // Vertical deltas of the DP column: +1 (pv) and -1 (mv) bits.
+        // The column starts at 0..m, so every delta is +1.
+        uint64_t pv = ~uint64_t{0};
+        uint64_t mv = 0;
+        const uint64_t last = uint64_t{1} << (length_ - 1);
+        size_t score = length_;
+
+        for (size_t j = 0; j < text.size(); ++j) {
+            uint64_t eq = peq_[static_cast<unsigned char>(text[j])];
+            uint64_t xv = eq | mv;
+            uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+            uint64_t ph = mv | ~(xh | pv);
+            uint64_t mh = pv & xh;
+
+            if (ph & last)      ++score;
+            else if (mh & last) --score;
+
+            ph = (ph << 1) | 1;   // row 0 grows by one per text char: global distance
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+
+            // The score drops by at most one per remaining character
+            if (score > maxDistance + (text.size() - j - 1)) return maxDistance + 1;
+        }
+        return static_cast<unsigned>(score);
+    }
+}
@@ -0,0 +1,125 @@
+/**
+ *  fuzzy.hpp — Typo-tolerant matching primitives
+ *
+ *  Pattern scores a candidate with the Myers/Hyyrö bit-parallel
+ *  Levenshtein algorithm: the whole DP column (up to 64 cells) lives in
+ *  a pair of machine words and advances by one text character per ~15
+ *  word operations. Candidates come from a deletion index in the
+ *  knowledge image (kb_image.hpp), or for more than DELETE_DEPTH edits
+ *  a trigram index; the helpers here define both.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace Fuzzy {
+
+    inline constexpr size_t   MAX_PATTERN      = 64;   // bits in a DP word
+    inline constexpr unsigned DEFAULT_DISTANCE = 2;
+
+    // Edits tolerated for an input of `length` bytes: about one per four
+    // characters, capped by the configured maximum. Short inputs get
+    // few edits, and the q-gram filter threshold stays positive.
+    constexpr unsigned allowedDistance(size_t length, unsigned maxDistance) {
+        size_t byLength = (length + 1) / 4;
+        return byLength < maxDistance ? static_cast<unsigned>(byLength) : maxDistance;
+    }
+
+    class Pattern {
+    public:
+        // False if `pattern` is empty or longer than MAX_PATTERN
+        bool assign(std::string_view pattern);
+
+        size_t size() const { return length_; }
+
+        // Levenshtein distance to `text`. Stops early once the distance
+        // is certain to exceed `maxDistance` and returns maxDistance + 1.
+        unsigned distance(std::string_view text, unsigned maxDistance) const;
+
+    private:
+        std::array<uint64_t, 256>           peq_{};   // bit i set: pattern[i] == c
+        std::array<unsigned char, MAX_PATTERN> chars_{};
+        size_t                              length_ = 0;
+    };
+
+    // ── Trigrams ────────────────────────────────────────────────
+    // Grams of the string padded with one sentinel byte on each side:
+    // a string of n bytes has n grams, and one edit changes at most 3.
+
+    inline constexpr unsigned char PAD = 0x01;
+
+    template <typename Fn>
+    void forEachTrigram(std::string_view s, Fn&& fn) {
+        auto at = [&s](size_t i) -> uint32_t {   // index into the padded string
+            return i == 0 || i > s.size() ? PAD : static_cast<unsigned char>(s[i - 1]);
+        };
+        for (size_t i = 0; i < s.size(); ++i)
+            fn(at(i) << 16 | at(i + 1) << 8 | at(i + 2));
+    }
+
+    // Index bucket hash of a gram within keys of one length (clamped
+    // to 255): the length is part of the bucket, so a lookup reads only
+    // keys of a length that can match
+    inline uint32_t trigramHash(uint32_t gram, size_t length) {
+        uint32_t h = gram | static_cast<uint32_t>(length < 255 ? length : 255) << 24;
+        h ^= h >> 16;
+        h *= 0x85EBCA6Bu;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35u;
+        return h ^ (h >> 16);
+    }
+
+    // ── Deletion neighbourhood ──────────────────────────────────
+    // Split a string into halves, the first taking the middle byte. If
+    // two strings are within two edits, the halves of one pair become
+    // equal once at most one byte is deleted from each; within one edit,
+    // both pairs do. So the index stores, for each half of a key, the
+    // half itself and every way of deleting one byte from it, and a
+    // lookup probes the same hashes of the input's first half — and of
+    // its second if the first found nothing within one edit.
+
+    inline constexpr unsigned DELETE_DEPTH = 2;   // edits the index answers for
+    inline constexpr size_t   MAX_DELETE_KEY = MAX_PATTERN + DELETE_DEPTH;
+    inline constexpr size_t   MAX_DELETIONS  = (MAX_DELETE_KEY + 1) / 2 + 1;   // hashes per half
+
+    // Calls fn(hash) for half `half` (0 or 1) of `s`, at most
+    // MAX_DELETE_KEY bytes, and for each deletion of one of its bytes.
+    // A variant reached by deleting either of two equal bytes is
+    // reported twice.
+    template <typename Fn>
+    void forEachDeletion(std::string_view s, unsigned half, Fn&& fn) {
+        const size_t middle = (s.size() + 1) / 2;
+        const std::string_view h = half == 0 ? s.substr(0, middle) : s.substr(middle);
+
+        // Polynomial hash, so a variant is assembled from the hashes of
+        // the pieces on either side of its deletion
+        constexpr uint64_t BASE = 0x100000001B3ull;
+        const size_t n = h.size();
+        uint64_t prefix[MAX_DELETIONS], power[MAX_DELETIONS];
+        prefix[0] = 0;
+        power[0]  = 1;
+        for (size_t i = 0; i < n; ++i) {
+            prefix[i + 1] = prefix[i] * BASE + static_cast<unsigned char>(h[i]) + 1;
+            power[i + 1]  = power[i] * BASE;
+        }
+        auto emit = [&](uint64_t x, size_t length) {
+            x ^= length << 1 | half;
+            x ^= x >> 33;
+            x *= 0xFF51AFD7ED558CCDull;
+            x ^= x >> 33;
+            x *= 0xC4CEB9FE1A85EC53ull;
+            x ^= x >> 33;
+            fn(x);
+        };
+
+        emit(prefix[n], n);
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t suffix = prefix[n] - prefix[i + 1] * power[n - i - 1];
+            emit(prefix[i] * power[n - i - 1] + suffix, n - 1);
+        }
+    }
+}
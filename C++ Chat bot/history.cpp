@@ -0,0 +1,279 @@
+/**
+ *  history.cpp — Ring-buffer history and the append-only message log
+ */
+
+#include "history.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+    constexpr char     LOG_MAGIC[8]  = {'C', 'H', 'A', 'T', 'L', 'O', 'G', '\0'};
+    constexpr uint64_t LOG_VERSION   = 1;
+    constexpr size_t   HEADER_BYTES  = 16;
+    constexpr size_t   FLUSH_BYTES   = 64 * 1024;   // flush early when this much is buffered
+
+    struct RecordHeader {
+        uint64_t prev;
+        uint64_t length;
+    };
+
+    size_t padded(size_t n) { return (n + 7) & ~size_t{7}; }
+}
+
+// ─── Log ────────────────────────────────────────────────────────
+
+HistoryLog::~HistoryLog() {
+    if (!file_) return;
+    flush();
+    std::fclose(file_);
+}
+
+bool HistoryLog::open(const std::string& path, std::string& error) {
+    std::FILE* f = std::fopen(path.c_str(), "ab+");
+    if (!f) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    std::setvbuf(f, nullptr, _IONBF, 0);   // buffering happens in buffer_
+
+    std::fseek(f, 0, SEEK_END);
+    long size = std::ftell(f);
+    if (size == 0) {
+        char header[HEADER_BYTES] = {};
+        std::memcpy(header, LOG_MAGIC, sizeof LOG_MAGIC);
+        std::memcpy(header + 8, &LOG_VERSION, sizeof LOG_VERSION);
+        if (std::fwrite(header, 1, sizeof header, f) != sizeof header) {
+            error = path + ": " + std::strerror(errno);
+            std::fclose(f);
+            return false;
+        }
+        size = HEADER_BYTES;
+    } else {
+        char header[HEADER_BYTES] = {};
+        uint64_t version = 0;
+        std::rewind(f);
+        bool ok = size >= static_cast<long>(HEADER_BYTES) &&
+                  std::fread(header, 1, sizeof header, f) == sizeof header &&
+                  std::memcmp(header, LOG_MAGIC, sizeof LOG_MAGIC) == 0;
+        if (ok) std::memcpy(&version, header + 8, sizeof version);
+        if (!ok || version != LOG_VERSION) {
+            error = path + ": not a chat history log";
+            std::fclose(f);
+            return false;
+        }
+
+        // A crash mid-write leaves a torn last record: cut it off
+        uint64_t end = HEADER_BYTES;
+        if (!map_.open(path, error)) {
+            std::fclose(f);
+            return false;
+        }
+        while (end + sizeof(RecordHeader) <= map_.size()) {
+            RecordHeader rec;
+            std::memcpy(&rec, map_.data() + end, sizeof rec);
+            if (rec.length > map_.size() - end - sizeof rec || rec.prev >= end) break;
+            uint64_t next = end + sizeof rec + padded(rec.length);
+            if (next > map_.size()) break;
+            end = next;
+        }
+        map_.close();
+        if (end != static_cast<uint64_t>(size)) {
+            std::error_code ec;
+            std::filesystem::resize_file(path, end, ec);
+            if (ec) {
+                error = path + ": " + ec.message();
+                std::fclose(f);
+                return false;
+            }
+            size = static_cast<long>(end);
+        }
+    }
+
+    file_ = f;
+    path_ = path;
+    size_ = static_cast<uint64_t>(size);
+    return true;
+}
+
+uint64_t HistoryLog::append(std::string_view message, uint64_t prev) {
+    if (!file_) return 0;
+
+    RecordHeader rec{prev, message.size()};
+    uint64_t offset = size_;
+    buffer_.append(reinterpret_cast<const char*>(&rec), sizeof rec);
+    buffer_.append(message.data(), message.size());
+    buffer_.append(padded(message.size()) - message.size(), '\0');
+    size_ += sizeof rec + padded(message.size());
+
+    if (buffer_.size() >= FLUSH_BYTES) flush();
+    return offset;
+}
+
+bool HistoryLog::flush() {
+    if (!file_ || buffer_.empty()) return !failed_;
+    if (std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+        if (!failed_) std::fprintf(stderr, "chatbot: history log %s: %s\n", path_.c_str(), std::strerror(errno));
+        failed_ = true;
+    }
+    buffer_.clear();
+    return !failed_;
+}
+
+bool HistoryLog::read(uint64_t offset, std::string_view& message, uint64_t& prev) {
+    if (!file_ || offset < HEADER_BYTES || offset % 8 != 0) return false;
+
+    // Remap only when the record lies beyond the current mapping
+    if (offset + sizeof(RecordHeader) > map_.size()) {
+        std::string error;
+        if (!flush() || !map_.open(path_, error)) return false;
+    }
+    if (offset + sizeof(RecordHeader) > map_.size()) return false;
+
+    RecordHeader rec;
+    std::memcpy(&rec, map_.data() + offset, sizeof rec);
+    if (rec.length > map_.size() - offset - sizeof rec || rec.prev >= offset) return false;
+
+    message = std::string_view(reinterpret_cast<const char*>(map_.data() + offset + sizeof rec),
+                               static_cast<size_t>(rec.length));
+    prev = rec.prev;
+    return true;
+}
+
+bool HistoryLog::readSessions(const std::string& path, std::vector<std::vector<std::string>>& sessions,
+                              std::string& error) {
+    MappedFile map;
+    if (!map.open(path, error)) return false;
+
+    uint64_t version = 0;
+    bool ok = map.size() >= HEADER_BYTES && std::memcmp(map.data(), LOG_MAGIC, sizeof LOG_MAGIC) == 0;
+    if (ok) std::memcpy(&version, map.data() + 8, sizeof version);
+    if (!ok || version != LOG_VERSION) {
+        error = path + ": not a chat history log";
+        return false;
+    }
+
+    // Records in file order; chains only link backwards, so find each
+    // record's successor first
+    struct Record {
+        uint64_t offset;
+        uint64_t prev;
+        std::string_view message;
+    };
+    std::vector<Record> records;
+    for (uint64_t offset = HEADER_BYTES; offset + sizeof(RecordHeader) <= map.size();) {
+        RecordHeader rec;
+        std::memcpy(&rec, map.data() + offset, sizeof rec);
+        if (rec.length > map.size() - offset - sizeof rec || rec.prev >= offset) break;
+        records.push_back({offset, rec.prev, {reinterpret_cast<const char*>(map.data() + offset + sizeof rec),
+                                              static_cast<size_t>(rec.length)}});
+        offset += sizeof rec + padded(rec.length);
+    }
+
+    constexpr size_t NONE = SIZE_MAX;
+    std::vector<size_t> next(records.size(), NONE);
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (records[i].prev == 0) continue;
+        auto it = std::lower_bound(records.begin(), records.begin() + i, records[i].prev,
+                                   [](const Record& r, uint64_t offset) { return r.offset < offset; });
+        if (it != records.begin() + i && it->offset == records[i].prev)
+            next[static_cast<size_t>(it - records.begin())] = i;
+    }
+
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (records[i].prev != 0) continue;
+        std::vector<std::string>& session = sessions.emplace_back();
+        for (size_t j = i; j != NONE; j = next[j]) session.emplace_back(records[j].message);
+    }
+    return true;
+}
+
+// ─── History ────────────────────────────────────────────────────
+
+void History::push(std::string_view message) {
+    if (!arena_) arena_ = std::make_unique<char[]>(ARENA_BYTES);
+
+    uint64_t logOffset = 0;
+    if (log_) {
+        logOffset = log_->append(message, lastLog_);
+        if (logOffset) {
+            if (lastLog_ == 0) firstLogged_ = total_;   // e.g. after restore()
+            lastLog_ = logOffset;
+        }
+    }
+
+    // Entries never straddle the arena end, so each is one contiguous view
+    size_t length = std::min(message.size(), MAX_ENTRY_BYTES);
+    uint64_t pos = writePos_;
+    if (pos % ARENA_BYTES + length > ARENA_BYTES) pos += ARENA_BYTES - pos % ARENA_BYTES;
+    writePos_ = pos + length;
+
+    // Evict what the new bytes overwrite, then make room in the ring
+    while (count_ > 0 && entry(0).pos + ARENA_BYTES < writePos_) {
+        head_ = (head_ + 1) % MAX_ENTRIES;
+        --count_;
+    }
+    if (count_ == MAX_ENTRIES) {
+        head_ = (head_ + 1) % MAX_ENTRIES;
+        --count_;
+    }
+
+    std::memcpy(arena_.get() + pos % ARENA_BYTES, message.data(), length);
+    entries_[(head_ + count_) % MAX_ENTRIES] = {pos, static_cast<uint32_t>(length), logOffset};
+    ++count_;
+    ++total_;
+}
+
+void History::clear() {
+    head_ = count_ = total_ = firstLogged_ = 0;
+    writePos_ = lastLog_ = 0;
+    log_ = nullptr;
+}
+
+void History::restore(const std::string_view* messages, size_t count, size_t total) {
+    HistoryLog* log = log_;
+    clear();
+    for (size_t i = 0; i < count; ++i) push(messages[i]);
+    total_ = std::max(total, total_);
+    log_   = log;
+}
+
+size_t History::firstAvailable() const {
+    size_t inMemory = total_ - count_;
+    if (count_ > 0 && entry(0).logOffset != 0) return firstLogged_;   // the log reaches back further
+    return inMemory;
+}
+
+bool History::get(size_t first, size_t last, std::vector<std::string_view>& out) {
+    out.clear();
+    first = std::max(first, firstAvailable());
+    last  = std::min(last, total_);
+    if (first >= last) return true;
+
+    const size_t memFirst = total_ - count_;
+
+    // Older part: walk the log back from the oldest entry still in RAM
+    if (first < memFirst) {
+        if (!log_ || count_ == 0 || entry(0).logOffset == 0) return false;
+        const size_t stop = std::min(last, memFirst);
+        std::string_view text;
+        uint64_t offset = 0;   // record of message i
+        if (!log_->read(entry(0).logOffset, text, offset)) return false;
+        for (size_t i = memFirst; i-- > first;) {
+            uint64_t prev = 0;
+            if (!log_->read(offset, text, prev)) return false;
+            if (i < stop) out.push_back(text);
+            offset = prev;
+        }
+        std::reverse(out.begin(), out.end());
+    }
+
+    for (size_t i = std::max(first, memFirst); i < last; ++i) {
+        const Entry& e = entry(i - memFirst);
+        out.emplace_back(arena_.get() + e.pos % ARENA_BYTES, e.length);
+    }
+    return true;
+}
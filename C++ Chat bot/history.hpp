@@ -0,0 +1,123 @@
+/**
+ *  history.hpp — Bounded conversation history and its on-disk log
+ *
+ *  A History keeps the most recent messages of one session in a fixed
+ *  ring whose bytes live in one small per-session arena, so memory stays
+ *  constant however long the session runs. With a HistoryLog attached,
+ *  every message is also appended to a binary log file, and older pages
+ *  are read back from it through mmap instead of being kept in RAM.
+ *
+ *  Log layout: a 16-byte file header, then records of
+ *
+ *      u64 prev      offset of the same session's previous record, 0 = none
+ *      u64 length
+ *      bytes         padded to 8
+ *
+ *  Sessions interleave freely; each one is a back-linked chain.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+// ─── Log ────────────────────────────────────────────────────────
+// Append-only and single-threaded: each thread that owns sessions owns
+// its own log. Appends are buffered and written with one write() per
+// flush().
+class HistoryLog {
+public:
+    HistoryLog() = default;
+    ~HistoryLog();
+    HistoryLog(const HistoryLog&) = delete;
+    HistoryLog& operator=(const HistoryLog&) = delete;
+
+    // Opens (or creates) the log for appending. A torn last record,
+    // left by a crash, is cut off.
+    bool open(const std::string& path, std::string& error);
+    bool isOpen() const { return file_ != nullptr; }
+
+    // Buffers one record and returns its offset; 0 if the log is closed
+    uint64_t append(std::string_view message, uint64_t prev);
+
+    // Writes everything buffered; false (once reported) on I/O errors
+    bool flush();
+
+    // Reads the record at `offset` through the mapping. The view stays
+    // valid until a read() past the mapped end remaps the file.
+    bool read(uint64_t offset, std::string_view& message, uint64_t& prev);
+
+    // Every session recorded in the log at `path`, each as its messages
+    // oldest first, in the order the sessions began (for replaying
+    // traffic). A truncated last record is ignored.
+    static bool readSessions(const std::string& path, std::vector<std::vector<std::string>>& sessions,
+                             std::string& error);
+
+private:
+    std::FILE*  file_ = nullptr;
+    std::string path_;
+    uint64_t    size_ = 0;        // file bytes, including what is still buffered
+    std::string buffer_;
+    MappedFile  map_;
+    bool        failed_ = false;
+};
+
+// ─── History ────────────────────────────────────────────────────
+class History {
+public:
+    static constexpr size_t MAX_ENTRIES     = 64;
+    static constexpr size_t ARENA_BYTES     = 4096;
+    static constexpr size_t MAX_ENTRY_BYTES = ARENA_BYTES / 4;   // longer ones are cut in RAM
+
+    void attachLog(HistoryLog* log) { log_ = log; }
+    bool hasLog() const { return log_ != nullptr; }
+
+    void push(std::string_view message);
+
+    // Forgets every message and detaches the log, keeping the arena for
+    // the next session
+    void clear();
+
+    // Replaces the messages with `messages` (oldest first, not logged
+    // again), the newest of `total` ever pushed — for a session restored
+    // from a snapshot (see snapshot.hpp)
+    void restore(const std::string_view* messages, size_t count, size_t total);
+
+    size_t total() const { return total_; }     // messages ever pushed
+    bool   empty() const { return total_ == 0; }
+
+    // Index of the oldest message that can still be shown: the first
+    // one logged, or else the oldest still in RAM
+    size_t firstAvailable() const;
+
+    // Messages [first, last) by absolute index, oldest first, starting
+    // no earlier than firstAvailable(). The views stay valid until the
+    // next push() or get(). False if the log cannot be read.
+    bool get(size_t first, size_t last, std::vector<std::string_view>& out);
+
+private:
+    struct Entry {
+        uint64_t pos;        // virtual arena offset; the byte lives at pos % ARENA_BYTES
+        uint32_t length;
+        uint64_t logOffset;  // 0 if not logged
+    };
+
+    std::unique_ptr<char[]>           arena_;   // allocated on first push
+    std::array<Entry, MAX_ENTRIES>    entries_{};
+    size_t                            head_  = 0;   // ring index of the oldest entry
+    size_t                            count_ = 0;
+    size_t                            total_ = 0;
+    uint64_t                          writePos_ = 0;
+    uint64_t                          lastLog_  = 0;
+    size_t                            firstLogged_ = 0;   // message the log chain starts at
+    HistoryLog*                       log_ = nullptr;
+
+    const Entry& entry(size_t i) const { return entries_[(head_ + i) % MAX_ENTRIES]; }
+};
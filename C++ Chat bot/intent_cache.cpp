@@ -0,0 +1,104 @@
+/**
+ *  intent_cache.cpp — Lock-free memo table for knowledge lookups
+ */
+
+#include "intent_cache.hpp"
+
+#include <cstring>
+
+#include "metrics.hpp"
+
+namespace {
+
+    constexpr uint64_t OCCUPIED = uint64_t{1} << 63;   // never set in an empty entry
+
+    constexpr uint64_t pack(IntentCache::Resolution r) {
+        return OCCUPIED | uint64_t{static_cast<uint8_t>(r.intent)} << 32 | r.response;
+    }
+
+    constexpr IntentCache::Resolution unpack(uint64_t payload) {
+        return {static_cast<Intent>(static_cast<uint8_t>(payload >> 32)),
+                static_cast<uint32_t>(payload)};
+    }
+
+    inline uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDu;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53u;
+        return h ^ (h >> 33);
+    }
+}
+
+IntentCache::IntentCache(size_t entries) {
+    if (entries == 0) return;
+    size_t size = 2;   // one two-way bucket at least
+    while (size < entries) size <<= 1;
+    entries_ = std::make_unique<Entry[]>(size);
+    mask_ = size - 1;
+}
+
+uint64_t IntentCache::hash(std::string_view input, unsigned maxDistance) {
+    // Eight bytes per multiply; the tail is zero-padded and the length
+    // mixed in, so inputs differing only in trailing zero bytes differ
+    uint64_t h = mix(input.size() * 0x9E3779B97F4A7C15u ^ maxDistance);
+    const char* p = input.data();
+    size_t left = input.size();
+    for (; left >= 8; p += 8, left -= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        h = (h ^ word) * 0x9FB21C651E98DF25u;
+        h ^= h >> 29;
+    }
+    if (left > 0) {
+        uint64_t word = 0;
+        std::memcpy(&word, p, left);
+        h = (h ^ word) * 0x9FB21C651E98DF25u;
+    }
+    return mix(h);
+}
+
+bool IntentCache::get(uint64_t hash, Resolution& out) const {
+    if (!entries_) return false;
+    const Entry* bucket = &entries_[hash & mask_ & ~size_t{1}];
+    for (int way = 0; way < 2; ++way) {
+        uint64_t payload = bucket[way].payload.load(std::memory_order_relaxed);
+        uint64_t check   = bucket[way].check.load(std::memory_order_relaxed);
+        if ((payload & OCCUPIED) && (check ^ payload) == hash) {
+            out = unpack(payload);
+            Metrics::count(Metrics::CacheEvent::Hit);
+            return true;
+        }
+    }
+    Metrics::count(Metrics::CacheEvent::Miss);
+    return false;
+}
+
+void IntentCache::put(uint64_t hash, Resolution resolution) {
+    if (!entries_) return;
+    Entry* bucket = &entries_[hash & mask_ & ~size_t{1}];
+
+    // An empty way (or one a racing writer already filled with this
+    // input) first; otherwise a hash bit picks the victim
+    Entry* target = nullptr;
+    for (int way = 0; way < 2 && !target; ++way) {
+        uint64_t payload = bucket[way].payload.load(std::memory_order_relaxed);
+        uint64_t check   = bucket[way].check.load(std::memory_order_relaxed);
+        if (!(payload & OCCUPIED) || (check ^ payload) == hash) target = &bucket[way];
+    }
+    if (!target) {
+        target = &bucket[(hash >> 32) & 1];
+        Metrics::count(Metrics::CacheEvent::Eviction);
+    }
+
+    uint64_t payload = pack(resolution);
+    target->payload.store(payload, std::memory_order_relaxed);
+    target->check.store(hash ^ payload, std::memory_order_relaxed);
+}
+
+void IntentCache::clear() {
+    for (size_t i = 0; i < capacity(); ++i) {
+        entries_[i].payload.store(0, std::memory_order_relaxed);
+        entries_[i].check.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ *  intent_cache.hpp — Memoized knowledge lookups
+ *
+ *  Real traffic repeats itself, and a message with no exact key pays for
+ *  the whole cascade — the partial-match scan, the typo search, then the
+ *  word search — every time it is seen. The cache remembers where that
+ *  cascade ended (a response id, or a miss) under a 64-bit hash of the
+ *  input and the typo allowance.
+ *
+ *  Lock-free and bounded: a fixed table of two-way buckets. An entry is
+ *  two words, the payload and payload ^ hash ("lockless hashing", as in
+ *  chess transposition tables). A reader accepts an entry only if the
+ *  two words agree with its hash, so a read torn by a concurrent writer
+ *  is just a miss. Each KnowledgeBase owns a cache, so a reload starts
+ *  with an empty one and stale answers cannot survive it.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+enum class Intent : uint8_t;   // engine.hpp
+
+class IntentCache {
+public:
+    static constexpr size_t DEFAULT_ENTRIES = 4096;
+
+    // `entries` is rounded up to a power of two; 0 disables the cache
+    explicit IntentCache(size_t entries);
+
+    IntentCache(const IntentCache&) = delete;
+    IntentCache& operator=(const IntentCache&) = delete;
+
+    size_t capacity() const { return mask_ ? mask_ + 1 : 0; }
+
+    struct Resolution {
+        Intent   intent;
+        uint32_t response;   // Kb::Image response id; unused for a miss
+    };
+
+    static uint64_t hash(std::string_view input, unsigned maxDistance);
+
+    // Both count a hit, a miss or an eviction in the calling thread's
+    // metrics shard (see metrics.hpp)
+    bool get(uint64_t hash, Resolution& out) const;
+    void put(uint64_t hash, Resolution resolution);
+
+    // Drops every entry; not safe while other threads use the cache
+    void clear();
+
+private:
+    struct Entry {
+        std::atomic<uint64_t> check{0};   // hash ^ payload
+        std::atomic<uint64_t> payload{0};
+    };
+
+    std::unique_ptr<Entry[]> entries_;
+    size_t                   mask_ = 0;
+};
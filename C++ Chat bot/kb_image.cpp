@@ -0,0 +1,660 @@
+/**
+ *  kb_image.cpp — Knowledge image compiler and reader
+ */
+
+#include "kb_image.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <type_traits>
+#include <unordered_map>
+
+#include "fuzzy.hpp"
+#include "util.hpp"
+
+namespace Kb {
+
+    uint32_t hashKey(std::string_view key) {
+        uint64_t h = 1469598103934665603ull;   // FNV-1a 64, folded to 32 bits
+        for (unsigned char c : key) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        return static_cast<uint32_t>(h ^ (h >> 32));
+    }
+
+    namespace {
+
+        // Appends 8-byte aligned sections to a growing image
+        class ImageWriter {
+        public:
+            ImageWriter() { bytes_.resize(sizeof(Header)); }
+
+            template <typename T>
+            Section append(const T* data, size_t count) {
+                static_assert(std::is_trivially_copyable_v<T>, "sections hold plain records");
+                bytes_.resize((bytes_.size() + 7) & ~size_t{7}, 0);
+                Section s{bytes_.size(), count};
+                const auto* p = reinterpret_cast<const unsigned char*>(data);
+                bytes_.insert(bytes_.end(), p, p + count * sizeof(T));
+                return s;
+            }
+
+            template <typename T>
+            Section append(const std::vector<T>& v) { return append(v.data(), v.size()); }
+
+            std::vector<unsigned char> finish(Header header) {
+                bytes_.resize((bytes_.size() + 7) & ~size_t{7}, 0);
+                header.size = bytes_.size();
+                std::memcpy(bytes_.data(), &header, sizeof header);
+                return std::move(bytes_);
+            }
+
+        private:
+            std::vector<unsigned char> bytes_;
+        };
+    }
+
+    namespace {
+        constexpr size_t MAX_FUZZY_KEYS      = size_t{1} << 24;   // key ids share a word with the length
+        constexpr size_t MAX_TRIGRAM_BUCKETS = size_t{1} << 20;
+
+        // std::lower_bound with the branch replaced by a conditional move:
+        // probes into short posting lists are otherwise mispredict-bound
+        const uint32_t* lowerBound(const uint32_t* first, const uint32_t* last, uint32_t value) {
+            size_t n = static_cast<size_t>(last - first);
+            if (n == 0) return first;
+            while (n > 1) {
+                size_t half = n / 2;
+                first = first[half] < value ? first + half : first;
+                n -= half;
+            }
+            return first + (*first < value);
+        }
+    }
+
+    std::vector<unsigned char> build(const Source& source) {
+        // Each distinct string is stored once: replies shared by
+        // several keys, or repeated jokes, point at the same bytes
+        std::string blob;
+        std::unordered_map<std::string, String> interned;
+        auto addString = [&blob, &interned](std::string_view s) {
+            auto [it, added] = interned.emplace(std::string(s), String{});
+            if (added) {
+                it->second = {static_cast<uint32_t>(blob.size()), static_cast<uint32_t>(s.size())};
+                blob.append(s.data(), s.size());
+            }
+            return it->second;
+        };
+
+        // Responses, deduplicated on the normalized key (last one wins)
+        std::vector<Response> responses;
+        std::unordered_map<std::string, uint32_t> responseIds;
+        for (const auto& [rawKey, text] : source.responses) {
+            std::string key = Util::normalize(rawKey);
+            if (key.empty()) continue;
+            auto [it, added] = responseIds.emplace(key, static_cast<uint32_t>(responses.size()));
+            if (added)
+                responses.push_back({addString(key), addString(text)});
+            else
+                responses[it->second].text = addString(text);
+        }
+
+        // Lookup keys. Aliases are resolved to a response id here, and
+        // an alias shadows a response key of the same spelling (aliases
+        // have always been checked first).
+        std::vector<Key> keys;
+        std::unordered_map<std::string, uint32_t> keyIds;
+        for (uint32_t id = 0; id < responses.size(); ++id) {
+            const Response& r = responses[id];
+            keyIds.emplace(blob.substr(r.key.offset, r.key.length), id);
+            keys.push_back({r.key, id, 0});
+        }
+        for (const auto& [rawAlias, rawTarget] : source.aliases) {
+            std::string alias = Util::normalize(rawAlias);
+            auto target = responseIds.find(Util::normalize(rawTarget));
+            if (alias.empty() || target == responseIds.end()) continue;
+
+            auto [it, added] = keyIds.emplace(alias, static_cast<uint32_t>(keys.size()));
+            if (added)
+                keys.push_back({addString(alias), target->second, KEY_ALIAS});
+            else
+                keys[it->second] = {keys[it->second].text, target->second, KEY_ALIAS};
+        }
+
+        // Open-addressing index, at most half full
+        size_t slots = 8;
+        while (slots < keys.size() * 2) slots <<= 1;
+        std::vector<Slot> index(slots, Slot{0, 0});
+        for (uint32_t id = 0; id < keys.size(); ++id) {
+            std::string_view text(blob.data() + keys[id].text.offset, keys[id].text.length);
+            uint32_t h = hashKey(text);
+            size_t i = h & (slots - 1);
+            while (index[i].key != 0) i = (i + 1) & (slots - 1);
+            index[i] = {h, id + 1};
+        }
+
+        // Partial-match automaton over keys long enough to be meaningful
+        std::vector<std::string> patterns;
+        std::vector<uint32_t> matchResponse;
+        for (const Key& k : keys) {
+            if (k.text.length < MIN_PARTIAL_KEY_LENGTH) continue;
+            patterns.push_back(blob.substr(k.text.offset, k.text.length));
+            matchResponse.push_back(k.response);
+        }
+        KeyMatcher matcher;
+        matcher.build(patterns);
+
+        // Trigram typo index. Keys are visited shortest first, so every
+        // bucket's posting list comes out sorted by value.
+        std::vector<uint32_t> trigramBegin, trigramPostings;
+        std::vector<VariantSlot> deleteSlots;
+        std::vector<uint32_t> deletePostings;
+        if (!keys.empty() && keys.size() < MAX_FUZZY_KEYS) {
+            size_t buckets = 256;
+            while (buckets < keys.size() * 4 && buckets < MAX_TRIGRAM_BUCKETS) buckets <<= 1;
+
+            std::vector<uint32_t> order(keys.size());
+            std::iota(order.begin(), order.end(), 0u);
+            std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) {
+                return keys[a].text.length < keys[b].text.length;
+            });
+
+            auto keyBuckets = [&](uint32_t id, std::vector<uint32_t>& out) {
+                out.clear();
+                std::string_view text(blob.data() + keys[id].text.offset, keys[id].text.length);
+                Fuzzy::forEachTrigram(text, [&](uint32_t gram) {
+                    out.push_back(Fuzzy::trigramHash(gram, text.size()) & (buckets - 1));
+                });
+                std::sort(out.begin(), out.end());
+                out.erase(std::unique(out.begin(), out.end()), out.end());
+            };
+
+            std::vector<uint32_t> scratch;
+            trigramBegin.assign(buckets + 1, 0);
+            for (uint32_t id : order) {
+                keyBuckets(id, scratch);
+                for (uint32_t b : scratch) ++trigramBegin[b + 1];
+            }
+            for (size_t b = 0; b < buckets; ++b) trigramBegin[b + 1] += trigramBegin[b];
+
+            std::vector<uint32_t> fill(trigramBegin.begin(), trigramBegin.end() - 1);
+            trigramPostings.resize(trigramBegin.back());
+            for (uint32_t id : order) {
+                uint32_t length = std::min<uint32_t>(keys[id].text.length, 255);
+                keyBuckets(id, scratch);
+                for (uint32_t b : scratch) trigramPostings[fill[b]++] = length << 24 | id;
+            }
+
+            // Deletion typo index: (variant hash, posting) pairs, grouped
+            // by hash into one list per variant. Keys too long to be
+            // scored are left out.
+            std::vector<std::pair<uint64_t, uint32_t>> variants;
+            std::vector<uint64_t> hashes;
+            for (uint32_t id = 0; id < keys.size(); ++id) {
+                const uint32_t length = keys[id].text.length;
+                if (length > Fuzzy::MAX_DELETE_KEY) continue;
+                const std::string_view text(blob.data() + keys[id].text.offset, length);
+                hashes.clear();
+                for (unsigned half = 0; half < 2; ++half)
+                    Fuzzy::forEachDeletion(text, half, [&](uint64_t h) { hashes.push_back(h); });
+                std::sort(hashes.begin(), hashes.end());
+                hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+                for (uint64_t h : hashes) variants.emplace_back(h, length << 24 | id);
+            }
+            std::sort(variants.begin(), variants.end());
+
+            size_t distinct = 0;
+            for (size_t i = 0; i < variants.size(); ++i)
+                distinct += i == 0 || variants[i].first != variants[i - 1].first;
+            size_t slots = 8;
+            while (slots < distinct * 2) slots <<= 1;   // at most half full
+            deleteSlots.assign(slots, VariantSlot{0, 0});
+            deletePostings.reserve(variants.size() + distinct);
+            for (size_t i = 0; i < variants.size();) {
+                const uint64_t h = variants[i].first;
+                size_t j = i;
+                while (j < variants.size() && variants[j].first == h) ++j;
+                size_t slot = h & (slots - 1);
+                while (deleteSlots[slot].postings != 0) slot = (slot + 1) & (slots - 1);
+                deleteSlots[slot].check = static_cast<uint32_t>(h >> 32);
+                if (j - i == 1) {
+                    deleteSlots[slot].postings = VariantSlot::SINGLE | variants[i++].second;
+                    continue;
+                }
+                deleteSlots[slot].postings = static_cast<uint32_t>(deletePostings.size() + 1);
+                deletePostings.push_back(static_cast<uint32_t>(j - i));
+                for (; i < j; ++i) deletePostings.push_back(variants[i].second);
+            }
+        }
+
+        // Word index for free-form questions; documents are key ids
+        std::vector<std::string_view> documents;
+        documents.reserve(keys.size());
+        for (const Key& k : keys) documents.emplace_back(blob.data() + k.text.offset, k.text.length);
+        Search::IndexBuilder search;
+        if (!keys.empty()) search.build(documents);
+
+        std::vector<String> jokes, facts;
+        for (const auto& j : source.jokes) jokes.push_back(addString(j));
+        for (const auto& f : source.facts) facts.push_back(addString(f));
+
+        // Serialize
+        ImageWriter w;
+        Header h{};
+        std::memcpy(h.magic, MAGIC, sizeof MAGIC);
+        h.version    = VERSION;
+        h.endianMark = ENDIAN_MARK;
+
+        h.blob      = w.append(blob.data(), blob.size());
+        h.responses = w.append(responses);
+        h.keys      = w.append(keys);
+        h.index     = w.append(index);
+        h.jokes     = w.append(jokes);
+        h.facts     = w.append(facts);
+
+        h.matchRoot       = w.append(matcher.rootNext().data(), matcher.rootNext().size());
+        h.matchEdgeBegin  = w.append(matcher.edgeBegin());
+        h.matchEdgeLabel  = w.append(matcher.edgeLabel());
+        h.matchEdgeTarget = w.append(matcher.edgeTarget());
+        h.matchFail       = w.append(matcher.fail());
+        h.matchOutLen     = w.append(matcher.outLen());
+        h.matchOutId      = w.append(matcher.outId());
+        h.matchResponse   = w.append(matchResponse);
+
+        h.deleteSlots     = w.append(deleteSlots);
+        h.deletePostings  = w.append(deletePostings);
+        h.trigramBegin    = w.append(trigramBegin);
+        h.trigramPostings = w.append(trigramPostings);
+
+        h.searchTerms     = w.append(search.terms());
+        h.searchSlots     = w.append(search.slots());
+        h.searchText      = w.append(search.text().data(), search.text().size());
+        h.searchPostings  = w.append(search.postings());
+        h.searchDocBegin  = w.append(search.docBegin());
+        h.searchDocTerms  = w.append(search.docTerms());
+        h.searchDocNorm   = w.append(search.docNorm());
+        h.searchDocWeight = w.append(search.docWeight());
+
+        return w.finish(h);
+    }
+
+    // ─── Image ──────────────────────────────────────────────────
+
+    bool Image::attach(const unsigned char* data, size_t size, std::string& error) {
+        *this = Image{};
+
+        if (size < sizeof(Header)) {
+            error = "not a knowledge image (too small)";
+            return false;
+        }
+        if (reinterpret_cast<uintptr_t>(data) % alignof(Header) != 0) {
+            error = "knowledge image is misaligned in memory";
+            return false;
+        }
+        const auto* h = reinterpret_cast<const Header*>(data);
+        if (std::memcmp(h->magic, MAGIC, sizeof MAGIC) != 0) {
+            error = "not a knowledge image (bad magic)";
+            return false;
+        }
+        if (h->endianMark != ENDIAN_MARK) {
+            error = "knowledge image was built for a different byte order";
+            return false;
+        }
+        if (h->version != VERSION) {
+            error = "knowledge image version " + std::to_string(h->version) +
+                    " is not supported (expected " + std::to_string(VERSION) + "); rebuild it with kbc";
+            return false;
+        }
+        if (h->size != size) {
+            error = "knowledge image is truncated";
+            return false;
+        }
+
+        bool ok = true;
+        auto section = [&](const Section& s, size_t elemSize) -> const unsigned char* {
+            if (s.offset % 8 != 0 || s.offset > size || s.count > (size - s.offset) / elemSize) {
+                ok = false;
+                return nullptr;
+            }
+            return data + s.offset;
+        };
+
+        blob_      = reinterpret_cast<const char*>(section(h->blob, 1));
+        responses_ = reinterpret_cast<const Response*>(section(h->responses, sizeof(Response)));
+        keys_      = reinterpret_cast<const Key*>(section(h->keys, sizeof(Key)));
+        index_     = reinterpret_cast<const Slot*>(section(h->index, sizeof(Slot)));
+        jokes_     = reinterpret_cast<const String*>(section(h->jokes, sizeof(String)));
+        facts_     = reinterpret_cast<const String*>(section(h->facts, sizeof(String)));
+        matchResponse_ = reinterpret_cast<const uint32_t*>(section(h->matchResponse, sizeof(uint32_t)));
+        deleteSlots_   = reinterpret_cast<const VariantSlot*>(section(h->deleteSlots, sizeof(VariantSlot)));
+        deletePostings_ = reinterpret_cast<const uint32_t*>(section(h->deletePostings, sizeof(uint32_t)));
+        trigramBegin_  = reinterpret_cast<const uint32_t*>(section(h->trigramBegin, sizeof(uint32_t)));
+        trigramPostings_ = reinterpret_cast<const uint32_t*>(section(h->trigramPostings, sizeof(uint32_t)));
+
+        MatcherView m;
+        m.rootNext   = reinterpret_cast<const uint32_t*>(section(h->matchRoot, sizeof(uint32_t)));
+        m.edgeBegin  = reinterpret_cast<const uint32_t*>(section(h->matchEdgeBegin, sizeof(uint32_t)));
+        m.edgeLabel  = section(h->matchEdgeLabel, 1);
+        m.edgeTarget = reinterpret_cast<const uint32_t*>(section(h->matchEdgeTarget, sizeof(uint32_t)));
+        m.fail       = reinterpret_cast<const uint32_t*>(section(h->matchFail, sizeof(uint32_t)));
+        m.outLen     = reinterpret_cast<const uint32_t*>(section(h->matchOutLen, sizeof(uint32_t)));
+        m.outId      = reinterpret_cast<const uint32_t*>(section(h->matchOutId, sizeof(uint32_t)));
+        m.states     = static_cast<uint32_t>(h->matchFail.count);
+        m.edges      = static_cast<uint32_t>(h->matchEdgeLabel.count);
+
+        Search::IndexView sv;
+        sv.terms     = reinterpret_cast<const Search::Term*>(section(h->searchTerms, sizeof(Search::Term)));
+        sv.slots     = reinterpret_cast<const uint32_t*>(section(h->searchSlots, sizeof(uint32_t)));
+        sv.text      = reinterpret_cast<const char*>(section(h->searchText, 1));
+        sv.postings  = section(h->searchPostings, 1);
+        sv.docBegin  = reinterpret_cast<const uint32_t*>(section(h->searchDocBegin, sizeof(uint32_t)));
+        sv.docTerms  = section(h->searchDocTerms, 1);
+        sv.docNorm   = reinterpret_cast<const float*>(section(h->searchDocNorm, sizeof(float)));
+        sv.docWeight = reinterpret_cast<const float*>(section(h->searchDocWeight, sizeof(float)));
+
+        // Shape checks that stay O(1). Array contents are checked where
+        // they are read: string references, ids and offsets against their
+        // sections, matcher states and edges in MatcherView::step().
+        const uint64_t slots = h->index.count;
+        ok = ok && slots > h->keys.count && (slots & (slots - 1)) == 0;
+        if (ok && m.states > 0) {
+            ok = h->matchRoot.count == 256 &&
+                 h->matchEdgeBegin.count == uint64_t{m.states} + 1 &&
+                 h->matchEdgeTarget.count == h->matchEdgeLabel.count &&
+                 h->matchOutLen.count == m.states && h->matchOutId.count == m.states &&
+                 m.edgeBegin[m.states] == h->matchEdgeLabel.count;
+        }
+        if (ok && h->trigramBegin.count > 0) {
+            const uint64_t buckets = h->trigramBegin.count - 1;
+            ok = buckets > 0 && (buckets & (buckets - 1)) == 0 &&
+                 trigramBegin_[buckets] == h->trigramPostings.count;
+        }
+        if (ok && h->deleteSlots.count > 0) {
+            const uint64_t slots = h->deleteSlots.count;
+            ok = (slots & (slots - 1)) == 0 && h->deletePostings.count < VariantSlot::SINGLE;
+        }
+        if (ok && h->searchTerms.count > 0) {
+            const uint64_t terms = h->searchTerms.count - 1, slotCount = h->searchSlots.count;
+            ok = slotCount > terms && (slotCount & (slotCount - 1)) == 0 &&
+                 h->searchPostings.count <= UINT32_MAX && h->searchText.count <= UINT32_MAX &&
+                 h->searchDocTerms.count <= UINT32_MAX &&
+                 h->searchDocBegin.count == h->keys.count + 1 &&
+                 h->searchDocNorm.count == h->keys.count && h->searchDocWeight.count == h->keys.count;
+            sv.termCount    = static_cast<uint32_t>(terms);
+            sv.slotCount    = static_cast<uint32_t>(slotCount);
+            sv.textSize     = static_cast<uint32_t>(h->searchText.count);
+            sv.postingsSize = static_cast<uint32_t>(h->searchPostings.count);
+            sv.docTermsSize = static_cast<uint32_t>(h->searchDocTerms.count);
+            sv.docCount     = static_cast<uint32_t>(h->keys.count);
+        }
+        if (!ok) {
+            error = "knowledge image is corrupt (bad section table)";
+            *this = Image{};
+            return false;
+        }
+
+        header_  = h;
+        matcher_ = m;
+        search_  = sv;
+        return true;
+    }
+
+    std::string_view Image::str(const String& s) const {
+        if (uint64_t{s.offset} + s.length > header_->blob.count) return {};
+        return std::string_view(blob_ + s.offset, s.length);
+    }
+
+    Image::Lookup Image::entry(uint32_t response, bool alias) const {
+        if (!header_ || response >= header_->responses.count) return {};
+        const Response& r = responses_[response];
+        return {true, alias, str(r.key), str(r.text), response};
+    }
+
+    Image::Lookup Image::find(std::string_view input) const {
+        if (!header_) return {};
+        const uint64_t mask = header_->index.count - 1;
+        const uint32_t h = hashKey(input);
+        for (uint64_t i = h & mask, probes = 0; probes <= mask; i = (i + 1) & mask, ++probes) {
+            const Slot& slot = index_[i];
+            if (slot.key == 0) return {};
+            if (slot.hash != h || slot.key > header_->keys.count) continue;
+            const Key& key = keys_[slot.key - 1];
+            if (str(key.text) == input) return entry(key.response, key.flags & KEY_ALIAS);
+        }
+        return {};
+    }
+
+    Image::Lookup Image::findPartial(std::string_view input) const {
+        if (!header_) return {};
+        uint32_t id = matcher_.longestMatch(input);
+        if (id == MatcherView::NO_MATCH || id >= header_->matchResponse.count) return {};
+        return entry(matchResponse_[id], false);
+    }
+
+    Image::Lookup Image::findRelated(std::string_view input) const {
+        if (!header_) return {};
+        uint32_t id = search_.best(input);
+        if (id == Search::IndexView::NO_MATCH || id >= header_->keys.count) return {};
+        return entry(keys_[id].response, keys_[id].flags & KEY_ALIAS);
+    }
+
+    // Per-thread findFuzzy() state; the per-key marks are reset by
+    // bumping a stamp
+    struct Image::FuzzyScratch {
+        struct Range {
+            const uint32_t* begin = nullptr;
+            const uint32_t* end   = nullptr;
+            size_t size() const { return static_cast<size_t>(end - begin); }
+        };
+
+        std::vector<uint32_t> stamp;
+        std::vector<uint16_t> hits;
+        std::vector<uint32_t> seen;     // candidate postings, each key once
+        uint32_t              generation = 0;
+        std::vector<uint32_t> grams;
+        std::vector<Range>    pieces;
+        Fuzzy::Pattern        pattern;
+    };
+
+    Image::Lookup Image::findFuzzy(std::string_view input, unsigned maxDistance) const {
+        if (!header_) return {};
+        const size_t length = input.size();
+        const unsigned k = Fuzzy::allowedDistance(length, maxDistance);
+        if (k == 0 || length > Fuzzy::MAX_PATTERN) return {};
+        const bool deletions = k <= Fuzzy::DELETE_DEPTH;
+        if ((deletions ? header_->deleteSlots.count : header_->trigramBegin.count) == 0) return {};
+
+        thread_local FuzzyScratch s;
+        const uint64_t keyCount = header_->keys.count;
+        if (s.stamp.size() < keyCount) {
+            s.stamp.assign(keyCount, 0);
+            s.hits.assign(keyCount, 0);
+            s.generation = 0;
+        }
+        if (++s.generation == 0) {
+            std::fill(s.stamp.begin(), s.stamp.end(), 0);
+            s.generation = 1;
+        }
+
+        // Candidates from s.seen[from] on, verified with the bit-parallel
+        // edit distance
+        s.pattern.assign(input);
+        uint32_t best = UINT32_MAX;
+        unsigned bestDistance = k + 1;
+        size_t bestGap = SIZE_MAX;
+        auto verify = [&](size_t from) {
+            for (size_t i = from; i < s.seen.size(); ++i)
+                __builtin_prefetch(blob_ + keys_[s.seen[i] & 0xFFFFFF].text.offset);
+            for (size_t i = from; i < s.seen.size(); ++i) {
+                const uint32_t id = s.seen[i] & 0xFFFFFF;
+                const size_t keyLength = keys_[id].text.length;
+                unsigned d = s.pattern.distance(str(keys_[id].text), bestDistance);
+                if (d > k) continue;
+                size_t gap = keyLength > length ? keyLength - length : length - keyLength;
+                if (d < bestDistance || (d == bestDistance && (gap < bestGap || (gap == bestGap && id < best)))) {
+                    best = id;
+                    bestDistance = d;
+                    bestGap = gap;
+                }
+            }
+        };
+
+        s.seen.clear();
+        if (!deletions) {
+            trigramCandidates(input, k, s);
+            verify(0);
+        } else {
+            // Every key within one edit comes up from the first half
+            deletionCandidates(input, 0, k, s);
+            verify(0);
+            if (k > 1 && bestDistance > 1) {
+                const size_t from = s.seen.size();
+                deletionCandidates(input, 1, k, s);
+                verify(from);
+            }
+        }
+        if (best == UINT32_MAX) return {};
+        return entry(keys_[best].response, keys_[best].flags & KEY_ALIAS);
+    }
+
+    void Image::deletionCandidates(std::string_view input, unsigned half, unsigned k, FuzzyScratch& s) const {
+        // The variants are hashed and their slots prefetched before any
+        // is read, so that the cache misses overlap instead of adding up
+        const uint64_t mask = header_->deleteSlots.count - 1;
+        uint64_t hashes[Fuzzy::MAX_DELETIONS];
+        size_t hashCount = 0;
+        Fuzzy::forEachDeletion(input, half, [&](uint64_t h) {
+            hashes[hashCount++] = h;
+            __builtin_prefetch(deleteSlots_ + (h & mask));
+        });
+
+        // Keys within k of the input's length, each once
+        const uint64_t keyCount = header_->keys.count;
+        const size_t   length   = input.size();
+        auto take = [&](uint32_t posting) {
+            const uint32_t id = posting & 0xFFFFFF;
+            const size_t keyLength = posting >> 24;
+            if (keyLength + k < length || keyLength > length + k || id >= keyCount) return;
+            if (s.stamp[id] == s.generation) return;
+            s.stamp[id] = s.generation;
+            s.seen.push_back(posting);
+            __builtin_prefetch(keys_ + id);
+        };
+
+        const uint64_t postingCount = header_->deletePostings.count;
+        for (size_t i = 0; i < hashCount; ++i) {
+            const uint32_t check = static_cast<uint32_t>(hashes[i] >> 32);
+            for (uint64_t j = hashes[i] & mask, probes = 0; probes <= mask; j = (j + 1) & mask, ++probes) {
+                const VariantSlot& slot = deleteSlots_[j];
+                if (slot.postings == 0) break;
+                if (slot.check != check) continue;
+                if (slot.postings & VariantSlot::SINGLE) {
+                    take(slot.postings & ~VariantSlot::SINGLE);
+                } else if (slot.postings - 1 < postingCount) {
+                    const uint32_t* list = deletePostings_ + (slot.postings - 1);
+                    const uint64_t count = std::min<uint64_t>(list[0], postingCount - slot.postings);
+                    for (uint64_t p = 1; p <= count; ++p) take(list[p]);
+                }
+                break;
+            }
+        }
+    }
+
+    void Image::trigramCandidates(std::string_view input, unsigned k, FuzzyScratch& s) const {
+        using Range = FuzzyScratch::Range;
+        // One list per distinct gram, in pieces: one bucket per key length
+        struct List {
+            size_t size  = 0;
+            size_t piece = 0;   // first of its `width` ranges in s.pieces
+        };
+
+        s.grams.clear();
+        Fuzzy::forEachTrigram(input, [&](uint32_t gram) { s.grams.push_back(gram); });
+        std::sort(s.grams.begin(), s.grams.end());
+        size_t occurrences[Fuzzy::MAX_PATTERN];
+        size_t listCount = 0;
+        for (size_t i = 0; i < s.grams.size(); ++i) {
+            if (i > 0 && s.grams[i] == s.grams[i - 1]) {
+                ++occurrences[listCount - 1];
+                continue;
+            }
+            s.grams[listCount] = s.grams[i];
+            occurrences[listCount++] = 1;
+        }
+        s.grams.resize(listCount);
+
+        // q-gram lemma: one edit destroys at most 3 gram occurrences, so a
+        // key within k edits lacks at most the `missing` distinct grams
+        // whose occurrences, fewest first, add up to 3k or less.
+        // Only keys within k of the input's length are looked up.
+        std::sort(occurrences, occurrences + listCount);
+        size_t missing = 0;
+        for (size_t budget = 3 * size_t{k}; missing < listCount && occurrences[missing] <= budget; ++missing)
+            budget -= occurrences[missing];
+        if (missing == listCount) return;
+        const size_t required = listCount - missing;
+
+        const uint64_t keyCount  = header_->keys.count;
+        const size_t   minLength = input.size() - k;
+        const size_t   width     = 2 * size_t{k} + 1;
+        const uint64_t mask      = header_->trigramBegin.count - 2;
+        const uint64_t postingCount = header_->trigramPostings.count;
+        s.pieces.resize(listCount * width);
+        List lists[Fuzzy::MAX_PATTERN];
+        for (size_t i = 0; i < listCount; ++i) {
+            lists[i].piece = i * width;
+            for (size_t w = 0; w < width; ++w) {
+                uint64_t b = Fuzzy::trigramHash(s.grams[i], minLength + w) & mask;
+                Range& r = s.pieces[i * width + w];
+                // Offsets are checked here, not in attach(): a damaged
+                // bucket reads as empty or cut short
+                const uint64_t end   = std::min<uint64_t>(trigramBegin_[b + 1], postingCount);
+                const uint64_t begin = std::min<uint64_t>(trigramBegin_[b], end);
+                r = {trigramPostings_ + begin, trigramPostings_ + end};
+                lists[i].size += r.size();
+            }
+        }
+
+        // Prefix filter: of any (missing + 2) lists a qualifying key is in
+        // at least two, so only the shortest ones are scanned and keys seen
+        // once are dropped. For the rest, the remaining lists are probed by
+        // binary search in the bucket of the key's length.
+        std::sort(lists, lists + listCount, [](const List& a, const List& b) { return a.size < b.size; });
+        const size_t prefix = std::min(listCount, missing + 2);
+        for (size_t i = 0; i < prefix; ++i) {
+            for (size_t w = 0; w < width; ++w) {
+                const Range& r = s.pieces[lists[i].piece + w];
+                for (const uint32_t* p = r.begin; p != r.end; ++p) {
+                    const uint32_t id = *p & 0xFFFFFF;
+                    if (id >= keyCount) continue;
+                    if (s.stamp[id] != s.generation) {
+                        s.stamp[id] = s.generation;
+                        s.hits[id] = 0;
+                        s.seen.push_back(*p);
+                    }
+                    ++s.hits[id];
+                }
+            }
+        }
+
+        size_t kept = 0;
+        for (uint32_t posting : s.seen) {
+            size_t hits = s.hits[posting & 0xFFFFFF];
+            if (hits + (listCount - prefix) < required) continue;
+
+            // Bucket collisions can admit keys of other lengths
+            const size_t keyLength = posting >> 24;
+            if (keyLength < minLength || keyLength >= minLength + width) continue;
+
+            for (size_t j = prefix; j < listCount && hits < required && hits + (listCount - j) >= required; ++j) {
+                const Range& r = s.pieces[lists[j].piece + (keyLength - minLength)];
+                const uint32_t* p = lowerBound(r.begin, r.end, posting);
+                hits += p != r.end && *p == posting;
+            }
+            if (hits >= required) s.seen[kept++] = posting;
+        }
+        s.seen.resize(kept);
+    }
+}
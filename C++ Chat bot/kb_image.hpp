@@ -0,0 +1,211 @@
+/**
+ *  kb_image.hpp — Compiled knowledge-base image
+ *
+ *  A knowledge base is compiled by `kbc` into one flat, position-
+ *  independent image that is answered from in place — no parsing and no
+ *  per-entry allocation on load. The built-in content is such an image
+ *  too, embedded in the binary as a constant array.
+ *
+ *  Layout: a Header followed by 8-byte aligned sections. All integers
+ *  are little-endian; every offset is relative to the image start.
+ *
+ *    blob         key and reply text, each distinct string once (String
+ *                 refers here)
+ *    responses    Response[]   canonical key + reply text
+ *    keys         Key[]        every lookup key: response keys and aliases,
+ *                              aliases already resolved to a response id
+ *    index        Slot[]       open-addressing hash table over `keys`
+ *    jokes, facts String[]
+ *    matcher*     Aho-Corasick arrays (see MatcherView) over keys of 3+
+ *                 bytes; matchResponse maps a matcher id to a response
+ *    delete*      typo index: open-addressing table of the one-byte
+ *                 deletion variants of key halves (see
+ *                 Fuzzy::forEachDeletion), each with the keys it came from
+ *    trigram*     typo index for larger allowances: buckets hashed from
+ *                 (trigram, key length), each listing the keys of that
+ *                 length with that trigram
+ *    search*      inverted word index over the keys (see search.hpp)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "matcher.hpp"
+#include "search.hpp"
+
+namespace Kb {
+
+    inline constexpr char     MAGIC[8]    = {'C', 'H', 'A', 'T', 'K', 'B', '\0', '\x1A'};
+    inline constexpr uint32_t VERSION     = 4;
+    inline constexpr uint32_t ENDIAN_MARK = 0x01020304;
+
+    inline constexpr size_t MIN_PARTIAL_KEY_LENGTH = 3;
+
+    // ── On-disk records ─────────────────────────────────────────
+
+    struct Section {
+        uint64_t offset;
+        uint64_t count;    // elements, not bytes
+    };
+
+    struct String {
+        uint32_t offset;   // into the blob
+        uint32_t length;
+    };
+
+    struct Response {
+        String key;
+        String text;
+    };
+
+    enum KeyFlags : uint32_t { KEY_ALIAS = 1 };
+
+    struct Key {
+        String   text;
+        uint32_t response;
+        uint32_t flags;
+    };
+
+    struct Slot {
+        uint32_t hash;
+        uint32_t key;      // index into keys + 1; 0 marks an empty slot
+    };
+
+    // Deletion index table entry (see Fuzzy::forEachDeletion)
+    struct VariantSlot {
+        static constexpr uint32_t SINGLE = 0x80000000;
+
+        uint32_t check;      // upper half of the variant hash; the lower half picks the slot
+        uint32_t postings;   // SINGLE | the only posting, or offset of the list + 1;
+                             // 0 marks an empty slot
+    };
+
+    struct Header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t endianMark;
+        uint64_t size;     // total image bytes
+
+        Section blob;
+        Section responses;
+        Section keys;
+        Section index;     // count is a power of two
+        Section jokes;
+        Section facts;
+
+        Section matchRoot;        // uint32_t[256]
+        Section matchEdgeBegin;   // uint32_t[states + 1]
+        Section matchEdgeLabel;   // uint8_t[edges]
+        Section matchEdgeTarget;  // uint32_t[edges]
+        Section matchFail;        // uint32_t[states]
+        Section matchOutLen;      // uint32_t[states]
+        Section matchOutId;       // uint32_t[states]
+        Section matchResponse;    // uint32_t[patterns]
+
+        Section deleteSlots;      // VariantSlot, a power of two
+        Section deletePostings;   // uint32_t: per list a count, then key length << 24 | key id
+
+        Section trigramBegin;     // uint32_t[buckets + 1], buckets a power of two
+        Section trigramPostings;  // uint32_t: min(key length, 255) << 24 | key id
+
+        Section searchTerms;      // Search::Term[terms + 1]; empty without an index
+        Section searchSlots;      // uint32_t, a power of two
+        Section searchText;       // char
+        Section searchPostings;   // uint8_t, varint doc id deltas per anchor list
+        Section searchDocBegin;   // uint32_t[keys + 1] into searchDocTerms
+        Section searchDocTerms;   // uint8_t, varint term id deltas per key
+        Section searchDocNorm;    // float[keys]
+        Section searchDocWeight;  // float[keys]
+    };
+
+    uint32_t hashKey(std::string_view key);
+
+    // ── Building ────────────────────────────────────────────────
+
+    // Uncompiled knowledge. Keys are normalized (trimmed, lowercased)
+    // by the builder; an alias whose target does not exist is dropped.
+    struct Source {
+        std::map<std::string, std::string> responses;   // key → reply
+        std::map<std::string, std::string> aliases;     // alias → response key
+        std::vector<std::string>           jokes;
+        std::vector<std::string>           facts;
+    };
+
+    std::vector<unsigned char> build(const Source& source);
+
+    // ── Reading ─────────────────────────────────────────────────
+
+    // Read-only view of an image held in memory or mapped from disk.
+    // attach() checks the header and section bounds only, so it takes
+    // constant time for any image size.
+    class Image {
+    public:
+        bool attach(const unsigned char* data, size_t size, std::string& error);
+
+        struct Lookup {
+            bool             found = false;
+            bool             alias = false;
+            std::string_view key;    // canonical response key
+            std::string_view text;
+            uint32_t         response = 0;   // id for entry()
+        };
+
+        // Exact or alias hit for a normalized input — one hash probe
+        Lookup find(std::string_view input) const;
+
+        // Response for the longest known key contained in `input`
+        Lookup findPartial(std::string_view input) const;
+
+        // Closest key within the typo allowance for `input` (see
+        // Fuzzy::allowedDistance); ties go to the key whose length is
+        // closest, then to the first key. maxDistance 0 disables it.
+        Lookup findFuzzy(std::string_view input, unsigned maxDistance) const;
+
+        // Response for the key that best shares the informative words
+        // of `input`, ranked by BM25 (see search.hpp)
+        Lookup findRelated(std::string_view input) const;
+
+        // The lookup result for response `response`, as find() and the
+        // other lookups return it; not found if the id is out of range
+        Lookup entry(uint32_t response, bool alias) const;
+
+        size_t responseCount() const { return header_ ? header_->responses.count : 0; }
+        size_t keyCount()      const { return header_ ? header_->keys.count : 0; }
+        size_t jokeCount()     const { return header_ ? header_->jokes.count : 0; }
+        size_t factCount()     const { return header_ ? header_->facts.count : 0; }
+
+        std::string_view joke(size_t i) const { return str(jokes_[i]); }
+        std::string_view fact(size_t i) const { return str(facts_[i]); }
+
+    private:
+        const Header*        header_ = nullptr;
+        const char*          blob_   = nullptr;
+        const Response*      responses_ = nullptr;
+        const Key*           keys_   = nullptr;
+        const Slot*          index_  = nullptr;
+        const String*        jokes_  = nullptr;
+        const String*        facts_  = nullptr;
+        const uint32_t*      matchResponse_ = nullptr;
+        const VariantSlot*   deleteSlots_ = nullptr;
+        const uint32_t*      deletePostings_ = nullptr;
+        const uint32_t*      trigramBegin_ = nullptr;
+        const uint32_t*      trigramPostings_ = nullptr;
+        MatcherView          matcher_;
+        Search::IndexView    search_;
+
+        // Bounds-checked against the blob: a damaged record reads as ""
+        std::string_view str(const String& s) const;
+
+        // findFuzzy() candidates, each once, from the deletion index (k
+        // up to Fuzzy::DELETE_DEPTH) or the trigram index
+        struct FuzzyScratch;
+        void deletionCandidates(std::string_view input, unsigned half, unsigned k, FuzzyScratch& s) const;
+        void trigramCandidates(std::string_view input, unsigned k, FuzzyScratch& s) const;
+    };
+}
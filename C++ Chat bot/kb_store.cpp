@@ -0,0 +1,206 @@
+/**
+ *  kb_store.cpp — Knowledge base publication, reclamation and reloading
+ *
+ *  Why readers cannot see freed memory: a reader announces the global
+ *  epoch, then loads the pointer. A reload swaps the pointer, then bumps
+ *  the epoch to E and retires the old version with E. A reader that
+ *  announced E or later loaded the pointer after the swap, so the old
+ *  version may be freed once no slot holds an epoch below E. All of it
+ *  is sequentially consistent, which keeps the argument this short.
+ */
+
+#include "kb_store.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHATBOT_HAVE_SIGHUP 1
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    constexpr int RECLAIM_RETRY_MS = 10;   // poll interval while old versions are pinned
+
+#ifdef CHATBOT_HAVE_SIGHUP
+    int g_reloadFd = -1;   // write end of the reloader's wake pipe
+
+    void onReloadSignal(int) {
+        int saved = errno;
+        char c = 'r';
+        ssize_t ignored = ::write(g_reloadFd, &c, 1);   // full pipe: a reload is already queued
+        (void)ignored;
+        errno = saved;
+    }
+#endif
+}
+
+KnowledgeStore::KnowledgeStore(std::unique_ptr<KnowledgeBase> initial, std::string path)
+    : current_(initial.get()), path_(std::move(path)), cacheEntries_(initial->cacheCapacity()) {
+    initial.release();
+}
+
+KnowledgeStore::~KnowledgeStore() {
+    stopReloader();
+    delete current_.load();
+    for (const Retired& r : retired_) delete r.kb;
+    for (Slot* s = slots_.load(); s;) delete std::exchange(s, s->next);
+}
+
+// ─── Readers ────────────────────────────────────────────────────
+
+KnowledgeStore::Reader::Reader(KnowledgeStore& store) : store_(store), slot_(nullptr) {
+    for (Slot* s = store.slots_.load(); s; s = s->next) {
+        bool free = false;
+        if (s->used.compare_exchange_strong(free, true)) {
+            slot_ = s;
+            return;
+        }
+    }
+    slot_ = new Slot;
+    slot_->next = store.slots_.load();
+    while (!store.slots_.compare_exchange_weak(slot_->next, slot_)) {}
+}
+
+KnowledgeStore::Reader::~Reader() {
+    slot_->epoch.store(IDLE);
+    slot_->used.store(false);
+}
+
+KnowledgeStore::Guard KnowledgeStore::Reader::pin() const {
+    slot_->epoch.store(store_.epoch_.load());
+    return Guard(slot_, store_.current_.load());
+}
+
+// ─── Writers ────────────────────────────────────────────────────
+
+bool KnowledgeStore::reload(std::string& error) {
+    auto next = std::make_unique<KnowledgeBase>(cacheEntries_);
+    if (!path_.empty() && !next->load(path_, error)) return false;
+
+    std::lock_guard<std::mutex> lock(writer_);
+    const KnowledgeBase* old = current_.exchange(next.release());
+    uint64_t epoch = epoch_.fetch_add(1) + 1;
+    retired_.push_back({old, epoch});
+    version_.fetch_add(1, std::memory_order_relaxed);
+    reclaim();
+    return true;
+}
+
+bool KnowledgeStore::reclaim() {
+    uint64_t oldest = IDLE;
+    for (Slot* s = slots_.load(); s; s = s->next)
+        oldest = std::min(oldest, s->epoch.load());
+
+    auto live = std::remove_if(retired_.begin(), retired_.end(), [oldest](const Retired& r) {
+        if (r.epoch > oldest) return false;
+        delete r.kb;
+        return true;
+    });
+    retired_.erase(live, retired_.end());
+    return !retired_.empty();
+}
+
+// ─── Background Reloader ────────────────────────────────────────
+
+#ifdef CHATBOT_HAVE_SIGHUP
+
+bool KnowledgeStore::startReloader(std::string& error) {
+    if (::pipe(wakeFd_) < 0) {
+        error = std::string("pipe: ") + std::strerror(errno);
+        return false;
+    }
+    for (int fd : wakeFd_) ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    ::fcntl(wakeFd_[1], F_SETFL, O_NONBLOCK);
+
+    reloader_ = std::thread(&KnowledgeStore::reloaderLoop, this);
+
+    g_reloadFd = wakeFd_[1];
+    struct sigaction sa{};
+    sa.sa_handler = onReloadSignal;
+    sa.sa_flags   = SA_RESTART;   // don't interrupt a blocked prompt read
+    ::sigemptyset(&sa.sa_mask);
+    ::sigaction(SIGHUP, &sa, nullptr);
+    return true;
+}
+
+void KnowledgeStore::requestReload() {
+    if (wakeFd_[1] < 0) {
+        std::string error;
+        if (!reload(error)) std::fprintf(stderr, "chatbot: reload failed: %s\n", error.c_str());
+        return;
+    }
+    char c = 'r';
+    ssize_t ignored = ::write(wakeFd_[1], &c, 1);
+    (void)ignored;
+}
+
+void KnowledgeStore::stopReloader() {
+    if (!reloader_.joinable()) return;
+    std::signal(SIGHUP, SIG_DFL);
+    g_reloadFd = -1;
+
+    char c = 'q';
+    while (::write(wakeFd_[1], &c, 1) < 0 && errno == EAGAIN)
+        std::this_thread::yield();   // pipe full of queued reloads
+    reloader_.join();
+    for (int& fd : wakeFd_) ::close(std::exchange(fd, -1));
+}
+
+void KnowledgeStore::reloaderLoop() {
+    bool pending = false;   // retired versions still pinned by readers
+    while (true) {
+        pollfd pfd{wakeFd_[0], POLLIN, 0};
+        int ready = ::poll(&pfd, 1, pending ? RECLAIM_RETRY_MS : -1);
+        if (ready < 0 && errno != EINTR) {
+            std::perror("chatbot: reloader poll");
+            return;
+        }
+
+        bool reloadNow = false, quit = false;
+        if (ready > 0) {
+            char buf[64];
+            ssize_t n = ::read(wakeFd_[0], buf, sizeof buf);   // requests coalesce
+            for (ssize_t i = 0; i < n; ++i) {
+                reloadNow |= buf[i] == 'r';
+                quit      |= buf[i] == 'q';
+            }
+        }
+        if (quit) return;
+
+        if (reloadNow) {
+            std::string error;
+            if (reload(error))
+                std::fprintf(stderr, "chatbot: knowledge base reloaded (version %llu)\n",
+                             static_cast<unsigned long long>(version()));
+            else
+                std::fprintf(stderr, "chatbot: reload failed, keeping version %llu: %s\n",
+                             static_cast<unsigned long long>(version()), error.c_str());
+        }
+
+        std::lock_guard<std::mutex> lock(writer_);
+        pending = reclaim();
+    }
+}
+
+#else  // no SIGHUP or pipes: reloads run on the requesting thread
+
+bool KnowledgeStore::startReloader(std::string&) { return true; }
+
+void KnowledgeStore::requestReload() {
+    std::string error;
+    if (!reload(error)) std::fprintf(stderr, "chatbot: reload failed: %s\n", error.c_str());
+}
+
+void KnowledgeStore::stopReloader() {}
+
+void KnowledgeStore::reloaderLoop() {}
+
+#endif
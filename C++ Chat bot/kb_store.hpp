@@ -0,0 +1,115 @@
+/**
+ *  kb_store.hpp — Hot-swappable knowledge base
+ *
+ *  The live KnowledgeBase is published through one atomic pointer.
+ *  Readers pin it with epoch-based reclamation: a read section costs two
+ *  stores and a load on the reader's own cache line — no lock, no wait,
+ *  no counter shared with other readers. A reload builds the new version
+ *  on a background thread, swaps the pointer, and frees the old version
+ *  once every reader that could still see it has left its read section.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine.hpp"
+
+class KnowledgeStore {
+    struct Slot;
+
+public:
+    // `path` is what reload() reads: a kbc image, or "" for the
+    // built-in content
+    KnowledgeStore(std::unique_ptr<KnowledgeBase> initial, std::string path);
+    ~KnowledgeStore();   // every Reader must be gone by now
+
+    KnowledgeStore(const KnowledgeStore&) = delete;
+    KnowledgeStore& operator=(const KnowledgeStore&) = delete;
+
+    // Keeps the version it pinned alive until destroyed. Short-lived:
+    // hold it for one message, never across blocking I/O.
+    class Guard {
+    public:
+        ~Guard() { slot_->epoch.store(IDLE, std::memory_order_release); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        const KnowledgeBase& operator*() const { return *kb_; }
+        const KnowledgeBase* operator->() const { return kb_; }
+
+    private:
+        friend class KnowledgeStore;
+        Guard(Slot* slot, const KnowledgeBase* kb) : slot_(slot), kb_(kb) {}
+        Slot*                slot_;
+        const KnowledgeBase* kb_;
+    };
+
+    // Read handle for one thread. A Reader's guards must not overlap.
+    class Reader {
+    public:
+        explicit Reader(KnowledgeStore& store);
+        ~Reader();
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        Guard pin() const;   // wait-free
+
+    private:
+        KnowledgeStore& store_;
+        Slot*           slot_;
+    };
+
+    // Starts the background reloader thread and routes SIGHUP to it
+    bool startReloader(std::string& error);
+
+    // Returns at once; the reloader does the work and logs the outcome
+    // to stderr. Safe from any thread. Without a running reloader the
+    // reload happens on the calling thread.
+    void requestReload();
+
+    // Builds and publishes a new version on the calling thread. On
+    // failure the live version stays and `error` says why.
+    bool reload(std::string& error);
+
+    uint64_t version() const { return version_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr uint64_t IDLE = UINT64_MAX;
+
+    // One per Reader, on its own cache line. Slots are recycled, never
+    // unlinked, so the writer can walk the list without coordination.
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{IDLE};   // epoch announced by a pinned reader
+        std::atomic<bool>     used{true};
+        Slot*                 next = nullptr;
+    };
+
+    struct Retired {
+        const KnowledgeBase* kb;
+        uint64_t             epoch;   // readers announcing this or later cannot see kb
+    };
+
+    std::atomic<const KnowledgeBase*> current_;
+    std::atomic<uint64_t>             epoch_{1};
+    std::atomic<uint64_t>             version_{1};
+    std::atomic<Slot*>                slots_{nullptr};
+
+    const std::string    path_;
+    const size_t         cacheEntries_;   // intent cache size for reloaded versions
+    std::mutex           writer_;     // serializes reloads; readers never touch it
+    std::vector<Retired> retired_;
+
+    std::thread reloader_;
+    int         wakeFd_[2] = {-1, -1};   // pipe: 'r' = reload, 'q' = quit
+
+    bool reclaim();   // frees what no reader can see; true if some remain
+    void reloaderLoop();
+    void stopReloader();
+};
@@ -0,0 +1,347 @@
+/**
+ *  kbc.cpp — Knowledge-base compiler
+ *
+ *  Compiles a text or JSON knowledge file into the binary image that
+ *  `chatbot --kb FILE` maps and answers from in place.
+ *
+ *  Text format:
+ *
+ *      # comment
+ *      [responses]
+ *      hi = Hello to you too! 👋
+ *      [aliases]
+ *      howdy = hi
+ *      [jokes]
+ *      One joke per line.
+ *      [facts]
+ *      One fact per line.
+ *
+ *  In values, "\n" starts a new reply line and "\\" is a backslash.
+ *
+ *  JSON format:
+ *
+ *      { "responses": { "hi": "Hello!" }, "aliases": { "howdy": "hi" },
+ *        "jokes": [ "..." ], "facts": [ "..." ] }
+ *
+ *  Usage:  kbc INPUT OUTPUT
+ *          kbc --cpp INPUT OUTPUT
+ *
+ *  With --cpp the image is written as a C++ include defining
+ *  `IMAGE`, an 8-byte aligned constexpr byte array: that is how the
+ *  built-in content (knowledge.txt) gets into the binary, with nothing
+ *  to construct at startup.
+ */
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "kb_image.hpp"
+#include "utf8.hpp"
+#include "util.hpp"
+
+namespace {
+
+    bool fail(const std::string& where, const std::string& what) {
+        std::fprintf(stderr, "kbc: %s: %s\n", where.c_str(), what.c_str());
+        return false;
+    }
+
+    // ─── Text Format ────────────────────────────────────────────
+
+    std::string unescape(std::string_view s) {
+        std::string out;
+        for (size_t i = 0; i < s.size(); ++i) {
+            if (s[i] == '\\' && i + 1 < s.size()) {
+                char next = s[++i];
+                out += next == 'n' ? '\n' : next;
+            } else {
+                out += s[i];
+            }
+        }
+        return out;
+    }
+
+    bool parseText(const std::string& path, const std::string& text, Kb::Source& src) {
+        enum class Section { None, Responses, Aliases, Jokes, Facts } section = Section::None;
+
+        std::istringstream in(text);
+        std::string raw;
+        for (int lineNo = 1; std::getline(in, raw); ++lineNo) {
+            std::string line(Util::trim(raw));
+            std::string where = path + ":" + std::to_string(lineNo);
+            if (line.empty() || line[0] == '#') continue;
+
+            if (line.front() == '[' && line.back() == ']') {
+                std::string name = Util::toLower(line.substr(1, line.size() - 2));
+                if      (name == "responses") section = Section::Responses;
+                else if (name == "aliases")   section = Section::Aliases;
+                else if (name == "jokes")     section = Section::Jokes;
+                else if (name == "facts")     section = Section::Facts;
+                else return fail(where, "unknown section [" + name + "]");
+                continue;
+            }
+
+            switch (section) {
+                case Section::None:
+                    return fail(where, "entry before the first [section]");
+                case Section::Jokes:
+                    src.jokes.push_back(unescape(line));
+                    break;
+                case Section::Facts:
+                    src.facts.push_back(unescape(line));
+                    break;
+                case Section::Responses:
+                case Section::Aliases: {
+                    auto eq = line.find('=');
+                    if (eq == std::string::npos) return fail(where, "expected 'key = value'");
+                    std::string key   = Util::normalize(line.substr(0, eq));
+                    std::string value(Util::trim(std::string_view(line).substr(eq + 1)));
+                    if (key.empty()) return fail(where, "empty key");
+
+                    auto& table = section == Section::Responses ? src.responses : src.aliases;
+                    if (table.count(key))
+                        std::fprintf(stderr, "kbc: %s: warning: duplicate key '%s' (last one wins)\n",
+                                     where.c_str(), key.c_str());
+                    table[key] = section == Section::Responses ? unescape(value) : Util::normalize(value);
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    // ─── JSON Format ────────────────────────────────────────────
+
+    class JsonReader {
+    public:
+        JsonReader(const std::string& path, const std::string& text) : path_(path), s_(text) {}
+
+        bool parse(Kb::Source& src) {
+            if (!expect('{')) return false;
+            if (peek() == '}') return ++pos_, trailing();
+            while (true) {
+                std::string name;
+                if (!string(name) || !expect(':')) return false;
+                bool ok = name == "responses" ? object(src.responses)
+                        : name == "aliases"   ? object(src.aliases)
+                        : name == "jokes"     ? array(src.jokes)
+                        : name == "facts"     ? array(src.facts)
+                        : error("unknown member \"" + name + "\"");
+                if (!ok) return false;
+                if (peek() == ',') { ++pos_; continue; }
+                return expect('}') && trailing();
+            }
+        }
+
+    private:
+        const std::string& path_;
+        const std::string& s_;
+        size_t pos_ = 0;
+
+        bool error(const std::string& what) {
+            size_t line = 1;
+            for (size_t i = 0; i < pos_ && i < s_.size(); ++i) line += s_[i] == '\n';
+            return fail(path_ + ":" + std::to_string(line), what);
+        }
+
+        char peek() {
+            while (pos_ < s_.size() && std::isspace(static_cast<unsigned char>(s_[pos_]))) ++pos_;
+            return pos_ < s_.size() ? s_[pos_] : '\0';
+        }
+
+        bool expect(char c) {
+            if (peek() != c) return error(std::string("expected '") + c + "'");
+            ++pos_;
+            return true;
+        }
+
+        bool trailing() {
+            return peek() == '\0' || error("unexpected data after the top-level object");
+        }
+
+        static void appendUtf8(std::string& out, uint32_t cp) {
+            if (cp < 0x80) {
+                out += static_cast<char>(cp);
+            } else if (cp < 0x800) {
+                out += static_cast<char>(0xC0 | (cp >> 6));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            } else if (cp < 0x10000) {
+                out += static_cast<char>(0xE0 | (cp >> 12));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            } else {
+                out += static_cast<char>(0xF0 | (cp >> 18));
+                out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+        }
+
+        bool hex4(uint32_t& cp) {
+            if (pos_ + 4 > s_.size()) return error("truncated \\u escape");
+            cp = 0;
+            for (int i = 0; i < 4; ++i) {
+                char c = s_[pos_++];
+                cp <<= 4;
+                if      (c >= '0' && c <= '9') cp |= static_cast<uint32_t>(c - '0');
+                else if (c >= 'a' && c <= 'f') cp |= static_cast<uint32_t>(c - 'a' + 10);
+                else if (c >= 'A' && c <= 'F') cp |= static_cast<uint32_t>(c - 'A' + 10);
+                else return error("bad \\u escape");
+            }
+            return true;
+        }
+
+        bool string(std::string& out) {
+            if (!expect('"')) return false;
+            out.clear();
+            while (pos_ < s_.size()) {
+                char c = s_[pos_++];
+                if (c == '"') return true;
+                if (c != '\\') { out += c; continue; }
+                if (pos_ >= s_.size()) break;
+                switch (char e = s_[pos_++]) {
+                    case 'n': out += '\n'; break;
+                    case 't': out += '\t'; break;
+                    case 'r': out += '\r'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'u': {
+                        uint32_t cp = 0;
+                        if (!hex4(cp)) return false;
+                        if (cp >= 0xD800 && cp < 0xDC00) {     // surrogate pair
+                            uint32_t lo = 0;
+                            if (s_.compare(pos_, 2, "\\u") != 0) return error("unpaired surrogate");
+                            pos_ += 2;
+                            if (!hex4(lo) || lo < 0xDC00 || lo > 0xDFFF) return error("unpaired surrogate");
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        }
+                        appendUtf8(out, cp);
+                        break;
+                    }
+                    default: out += e;   // \" \\ \/
+                }
+            }
+            return error("unterminated string");
+        }
+
+        bool object(std::map<std::string, std::string>& table) {
+            if (!expect('{')) return false;
+            if (peek() == '}') return ++pos_, true;
+            std::string key, value;
+            while (true) {
+                if (!string(key) || !expect(':') || !string(value)) return false;
+                table[Util::normalize(key)] = value;
+                if (peek() == ',') { ++pos_; continue; }
+                return expect('}');
+            }
+        }
+
+        bool array(std::vector<std::string>& list) {
+            if (!expect('[')) return false;
+            if (peek() == ']') return ++pos_, true;
+            std::string value;
+            while (true) {
+                if (!string(value)) return false;
+                list.push_back(value);
+                if (peek() == ',') { ++pos_; continue; }
+                return expect(']');
+            }
+        }
+    };
+
+    // ─── Files ──────────────────────────────────────────────────
+
+    bool readFile(const std::string& path, std::string& out) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return fail(path, "cannot open file");
+        std::ostringstream ss;
+        ss << in.rdbuf();
+        out = ss.str();
+        return true;
+    }
+
+    // Writes next to the target and renames, so a running bot never
+    // maps a half-written image
+    bool writeFileAtomic(const std::string& path, const void* data, size_t size) {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            out.close();   // the last flush can fail too (ENOSPC, EIO)
+            if (!out) {
+                std::remove(tmp.c_str());
+                return fail(tmp, "cannot write file");
+            }
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            return fail(path, "cannot replace file");
+        }
+        return true;
+    }
+
+    // The image as a C++ include, sixteen bytes per line
+    std::string cppSource(const std::string& input, const std::vector<unsigned char>& image) {
+        static constexpr char HEX[] = "0123456789abcdef";
+        std::string out = "// Generated by kbc from " + input + " — do not edit\n"
+                          "alignas(8) constexpr unsigned char IMAGE[] = {\n";
+        out.reserve(out.size() + image.size() * 6 + 16);
+        for (size_t i = 0; i < image.size(); ++i) {
+            out += i % 16 == 0 ? "    " : " ";
+            out += "0x";
+            out += HEX[image[i] >> 4];
+            out += HEX[image[i] & 0xF];
+            out += ',';
+            if (i % 16 == 15 || i + 1 == image.size()) out += '\n';
+        }
+        out += "};\n";
+        return out;
+    }
+}
+
+int main(int argc, char** argv) {
+    const bool cpp = argc == 4 && std::string_view(argv[1]) == "--cpp";
+    if (argc != 3 && !cpp) {
+        std::fprintf(stderr, "Usage: kbc [--cpp] INPUT OUTPUT\n"
+                             "  Compiles a text or JSON knowledge file into a binary image\n"
+                             "  for `chatbot --kb OUTPUT`, or with --cpp into a C++ include\n"
+                             "  defining it as `constexpr unsigned char IMAGE[]`.\n");
+        return 2;
+    }
+    const std::string input = argv[argc - 2], output = argv[argc - 1];
+
+    std::string text;
+    if (!readFile(input, text)) return 1;
+    if (!Utf8::valid(text)) {
+        fail(input, "not valid UTF-8");
+        return 1;
+    }
+
+    Kb::Source src;
+    auto first = text.find_first_not_of(" \t\r\n");
+    bool json = first != std::string::npos && text[first] == '{';
+    bool ok = json ? JsonReader(input, text).parse(src) : parseText(input, text, src);
+    if (!ok) return 1;
+
+    for (const auto& [alias, target] : src.aliases)
+        if (!src.responses.count(target))
+            std::fprintf(stderr, "kbc: warning: alias '%s' points to unknown key '%s' (dropped)\n",
+                         alias.c_str(), target.c_str());
+
+    std::vector<unsigned char> image = Kb::build(src);
+    if (cpp) {
+        std::string source = cppSource(input, image);
+        if (!writeFileAtomic(output, source.data(), source.size())) return 1;
+    } else if (!writeFileAtomic(output, image.data(), image.size())) {
+        return 1;
+    }
+
+    std::printf("kbc: %zu responses, %zu aliases, %zu jokes, %zu facts -> %s (%zu bytes)\n",
+                src.responses.size(), src.aliases.size(), src.jokes.size(), src.facts.size(),
+                output.c_str(), image.size());
+    return 0;
+}
@@ -0,0 +1,700 @@
+/**
+ *  loadgen.cpp — Traffic replay and load generation
+ *
+ *  Plays conversations against the engine from many concurrent sessions
+ *  and reports what was achieved: throughput, latency percentiles and
+ *  errors. Conversations come from recordings — history logs written
+ *  with --history-log, or text files with one message per line and a
+ *  blank line between conversations — or from a synthetic mix of
+ *  greetings, commands, calculator sessions, typos and misses.
+ *
+ *  In process (the default), worker threads call respond() the way the
+ *  server does, against the built-in content or --kb. With --connect,
+ *  every session is a connection to a running `chatbot --serve`.
+ *
+ *  Each session plays one conversation, then starts over as a new
+ *  session with the next one. Sessions send one message at a time. With
+ *  --rate, messages are sent on a fixed schedule and latency is measured
+ *  from the scheduled time, so a stall shows up in the percentiles
+ *  instead of silently lowering the rate.
+ *
+ *  Build & run:  make loadgen
+ *                ./chat_loadgen [options]      (see --help)
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "commands.hpp"
+#include "engine.hpp"
+#include "history.hpp"
+#include "kb_store.hpp"
+#include "metrics.hpp"
+#include "random.hpp"
+#include "util.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+    using Conversation = std::vector<std::string>;
+
+    struct Options {
+        std::vector<std::string> replay;
+        size_t      synthetic = 0;        // conversations; default when nothing is replayed
+        std::string connect;              // "" = in process
+        std::string kbPath;
+        size_t      sessions = 64;
+        unsigned    threads  = 0;         // 0 = min(cores, sessions)
+        double      rate     = 0;         // messages per second overall; 0 = as fast as possible
+        double      duration = 10;        // seconds
+        uint64_t    messages = 0;         // stop after this many; 0 = no limit
+        std::optional<uint64_t> seed;
+        std::string jsonPath;
+    };
+
+    // ─── Conversations ──────────────────────────────────────────
+
+    // Lines that would end the session or reload the server are left
+    // out of replays: every conversation runs to its end. History logs
+    // do not record what was typed into the calculator, so "calc" is
+    // dropped from them too, or it would swallow the rest of the chat.
+    bool replayable(std::string_view message, bool fromLog) {
+        std::string line(message);
+        Util::normalizeInPlace(line);
+        Command command = Commands::lookup(line);
+        return !line.empty() && command != Command::Exit && command != Command::Reload &&
+               !(fromLog && command == Command::Calc);
+    }
+
+    void addConversation(std::vector<Conversation>& out, Conversation& conversation, bool fromLog) {
+        conversation.erase(std::remove_if(conversation.begin(), conversation.end(),
+                                          [fromLog](const std::string& m) { return !replayable(m, fromLog); }),
+                           conversation.end());
+        if (!conversation.empty()) out.push_back(std::move(conversation));
+        conversation.clear();
+    }
+
+    bool loadReplay(const std::string& path, std::vector<Conversation>& out, std::string& error) {
+        std::vector<Conversation> sessions;
+        if (HistoryLog::readSessions(path, sessions, error)) {
+            for (Conversation& c : sessions) addConversation(out, c, true);
+            return true;
+        }
+
+        // Not a log: text, conversations separated by blank lines
+        std::FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f) {
+            error = path + ": " + std::strerror(errno);
+            return false;
+        }
+        error.clear();
+        Conversation conversation;
+        std::string line;
+        char buf[4096];
+        while (std::fgets(buf, sizeof buf, f)) {
+            line += buf;
+            if (line.back() != '\n' && !std::feof(f)) continue;   // longer than buf
+            while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+            if (Util::trim(line).empty())
+                addConversation(out, conversation, false);
+            else
+                conversation.push_back(line);
+            line.clear();
+        }
+        addConversation(out, conversation, false);
+        std::fclose(f);
+        return true;
+    }
+
+    // A mix of what real sessions send: small talk and questions,
+    // commands, calculator sessions, typos, free-form questions, misses
+    std::vector<Conversation> syntheticConversations(size_t count, uint64_t seed) {
+        static const char* const KNOWN[] = {
+            "hi", "hello", "good morning", "how are you?", "what is your name", "who made you?",
+            "what is c++?", "thanks", "are you a bot?", "what's up?", "sup", "gm"};
+        static const char* const COMMANDS[] = {
+            "joke", "fact", "time", "flip", "roll", "uptime", "history", "help", "stats",
+            "reverse hello world", "count the quick brown fox"};
+        static const char* const FUZZY[] = {
+            "helo", "whats yur name?", "who mde you?", "are you a robt?", "good mornin"};
+        static const char* const FREE_FORM[] = {
+            "can you tell me what c++ is", "tell me who made you please", "are you actually a real robot"};
+        static const char* const MISSES[] = {
+            "purple elephants dance", "xyzzy", "the quick brown fox jumps over the lazy dog", "qwertyuiop"};
+
+        Random random(seed);
+        auto pick = [&random](const auto& list) {
+            return std::string(list[random.below(static_cast<uint32_t>(std::size(list)))]);
+        };
+
+        std::vector<Conversation> out(count);
+        for (Conversation& c : out) {
+            for (int turns = random.between(3, 12); turns > 0; --turns) {
+                uint32_t kind = random.below(100);
+                if (kind < 35) {
+                    c.push_back(pick(KNOWN));
+                } else if (kind < 60) {
+                    c.push_back(pick(COMMANDS));
+                } else if (kind < 72) {
+                    c.push_back("calc");
+                    for (int n = random.between(1, 4); n > 0; --n) {
+                        int a = random.between(1, 999), b = random.between(1, 99);
+                        switch (random.below(4)) {
+                            case 0:  c.push_back("(" + std::to_string(a) + " + " + std::to_string(b) + ") * 2"); break;
+                            case 1:  c.push_back("sqrt(" + std::to_string(a) + ")"); break;
+                            case 2:  c.push_back("r = " + std::to_string(b)); c.push_back("pi * r ^ 2"); break;
+                            default: c.push_back(std::to_string(a) + " / " + std::to_string(b)); break;
+                        }
+                    }
+                    c.push_back("done");
+                } else if (kind < 82) {
+                    c.push_back(pick(FUZZY));
+                } else if (kind < 88) {
+                    c.push_back(pick(FREE_FORM));
+                } else {
+                    c.push_back(pick(MISSES) + " " + std::to_string(random.below(1000)));
+                }
+            }
+        }
+        return out;
+    }
+
+    // ─── Measurements ───────────────────────────────────────────
+
+    // One per thread, merged at the end. Latencies go into the same
+    // log-linear buckets as the engine's own metrics.
+    struct Tally {
+        Metrics::IntentStats latency;
+        uint64_t maxNs  = 0;
+        uint64_t errors = 0;
+
+        void add(uint64_t ns) {
+            ++latency.count;
+            latency.sumNs += ns;
+            ++latency.buckets[Metrics::bucketOf(ns)];
+            maxNs = std::max(maxNs, ns);
+        }
+
+        void merge(const Tally& other) {
+            latency.count += other.latency.count;
+            latency.sumNs += other.latency.sumNs;
+            for (size_t i = 0; i < Metrics::BUCKETS; ++i) latency.buckets[i] += other.latency.buckets[i];
+            maxNs = std::max(maxNs, other.maxNs);
+            errors += other.errors;
+        }
+    };
+
+    uint64_t nsBetween(Clock::time_point from, Clock::time_point to) {
+        return to > from ? static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count())
+                         : 0;
+    }
+
+    // Shared by the threads of one run
+    struct Plan {
+        const std::vector<Conversation>* conversations;
+        std::atomic<size_t> nextConversation{0};
+        Clock::time_point   start, end;
+        std::optional<uint64_t> seed;
+
+        const Conversation& take(uint64_t& ordinal) {
+            ordinal = nextConversation.fetch_add(1, std::memory_order_relaxed);
+            return (*conversations)[ordinal % conversations->size()];
+        }
+    };
+
+    // Fixed-rate send schedule for one thread; unthrottled if interval is 0
+    struct Pacer {
+        Clock::duration   interval{};
+        Clock::time_point next;
+
+        // When the next message is due; at least `now` when unthrottled
+        Clock::time_point due(Clock::time_point now) const { return interval.count() ? next : now; }
+        void advance() { next += interval; }
+    };
+
+    // Sleeps most of the way and spins the rest: the scheduler's wake-up
+    // slack would otherwise show up in every paced latency
+    void waitUntil(Clock::time_point due) {
+        constexpr auto SPIN = std::chrono::microseconds(200);
+        if (due - Clock::now() > SPIN) std::this_thread::sleep_until(due - SPIN);
+        while (Clock::now() < due) {}
+    }
+
+    Pacer makePacer(const Options& options, const Plan& plan, unsigned threads) {
+        Pacer p;
+        p.next = plan.start;
+        if (options.rate > 0)
+            p.interval = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(threads / options.rate));
+        return p;
+    }
+
+    // ─── In Process ─────────────────────────────────────────────
+
+    void runInProcess(KnowledgeStore& store, Plan& plan, size_t sessions, Pacer pacer,
+                      uint64_t quota, Tally& tally) {
+        struct Player {
+            Session session;
+            const Conversation* conversation = nullptr;
+            size_t next = 0;
+        };
+        KnowledgeStore::Reader reader(store);
+        std::vector<Player> players(sessions);
+        auto begin = [&plan](Player& p) {
+            uint64_t ordinal;
+            p.conversation = &plan.take(ordinal);
+            p.next = 0;
+            p.session.reset();
+            if (plan.seed) p.session.random.reseed(*plan.seed + ordinal);
+        };
+        for (Player& p : players) begin(p);
+
+        std::string line;
+        line.reserve(256);
+        for (uint64_t sent = 0; sent < quota; ++sent) {
+            Player& p = players[sent % players.size()];
+            Clock::time_point due = pacer.due(Clock::now());
+            if (due >= plan.end) break;
+            waitUntil(due);
+            Clock::time_point start = pacer.interval.count() ? due : Clock::now();
+            pacer.advance();
+
+            line.assign((*p.conversation)[p.next]);
+            Util::normalizeInPlace(line);
+            Response reply;
+            {
+                auto kb = reader.pin();
+                reply = respond(*kb, p.session, line);
+            }
+            tally.add(nsBetween(start, Clock::now()));
+
+            if (++p.next == p.conversation->size() || reply.has(Response::EndSession)) begin(p);
+        }
+    }
+
+    // ─── Over a Socket ──────────────────────────────────────────
+
+#ifdef __linux__
+
+    constexpr auto REPLY_TIMEOUT = std::chrono::seconds(5);
+
+    // Blocking connect, then non-blocking use; -1 on failure
+    int connectTo(const std::string& address) {
+        const std::string unixPrefix = "unix:";
+        if (address.compare(0, unixPrefix.size(), unixPrefix) == 0) {
+            sockaddr_un addr{};
+            std::string path = address.substr(unixPrefix.size());
+            if (path.size() >= sizeof(addr.sun_path)) return -1;
+            addr.sun_family = AF_UNIX;
+            std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+            int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd < 0) return -1;
+            if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) {
+                ::close(fd);
+                return -1;
+            }
+            ::fcntl(fd, F_SETFL, O_NONBLOCK);
+            return fd;
+        }
+
+        std::string host = "127.0.0.1", port = address;
+        auto colon = address.rfind(':');
+        if (colon != std::string::npos) {
+            host = address.substr(0, colon);
+            port = address.substr(colon + 1);
+            if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+                host = host.substr(1, host.size() - 2);
+        }
+        addrinfo hints{};
+        hints.ai_family   = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* res = nullptr;
+        if (::getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0) return -1;
+
+        int fd = -1;
+        for (addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+            fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd >= 0 && ::connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        ::freeaddrinfo(res);
+        if (fd < 0) return -1;
+        int on = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+        ::fcntl(fd, F_SETFL, O_NONBLOCK);
+        return fd;
+    }
+
+    void runOverSocket(const std::string& address, Plan& plan, size_t sessions, Pacer pacer,
+                       uint64_t quota, Tally& tally) {
+        struct Player {
+            int fd = -1;
+            const Conversation* conversation = nullptr;
+            size_t next = 0;
+            bool   waiting = false;            // a message is out, its reply not yet in
+            Clock::time_point sentAt;
+            std::string in;
+        };
+
+        int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epfd < 0) {
+            std::perror("loadgen: epoll");
+            ++tally.errors;
+            return;
+        }
+        std::vector<Player> players(sessions);
+        std::vector<Player*> idle;
+
+        // Closes the player's connection (if any) and opens one for its
+        // next conversation; a failed connect counts as an error and
+        // leaves the player out of the run
+        auto begin = [&](Player& p) {
+            if (p.fd >= 0) ::close(p.fd);
+            uint64_t ordinal;
+            p.conversation = &plan.take(ordinal);
+            p.next = 0;
+            p.waiting = false;
+            p.in.clear();
+            p.fd = connectTo(address);
+            epoll_event ev{};
+            ev.events   = EPOLLIN;
+            ev.data.ptr = &p;
+            if (p.fd < 0 || ::epoll_ctl(epfd, EPOLL_CTL_ADD, p.fd, &ev) < 0) {
+                ++tally.errors;
+                if (p.fd >= 0) ::close(p.fd);
+                p.fd = -1;
+                return;
+            }
+            idle.push_back(&p);
+        };
+        for (Player& p : players) begin(p);
+
+        uint64_t sent = 0;
+        std::string message;
+        epoll_event events[256];
+        char buf[16384];
+        while (true) {
+            Clock::time_point now = Clock::now();
+            if (now >= plan.end) break;
+
+            // Send while messages are due and sessions are free
+            while (!idle.empty() && sent < quota && pacer.due(now) <= now) {
+                Player& p = *idle.back();
+                idle.pop_back();
+                message.assign((*p.conversation)[p.next]).push_back('\n');
+                ssize_t n = ::send(p.fd, message.data(), message.size(), MSG_NOSIGNAL);
+                if (n != static_cast<ssize_t>(message.size())) {   // a short line never blocks a fresh socket
+                    ++tally.errors;
+                    begin(p);
+                    continue;
+                }
+                p.sentAt = pacer.interval.count() ? pacer.due(now) : now;
+                p.waiting = true;
+                pacer.advance();
+                ++sent;
+            }
+
+            bool busy = std::any_of(players.begin(), players.end(), [](const Player& p) { return p.waiting; });
+            if (sent >= quota && !busy) break;
+            if (players.size() && idle.empty() && !busy &&
+                std::none_of(players.begin(), players.end(), [](const Player& p) { return p.fd >= 0; }))
+                break;   // nothing connected
+
+            int timeoutMs = 100;
+            if (!idle.empty() && sent < quota && pacer.interval.count()) {
+                auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(pacer.due(now) - now);
+                timeoutMs = static_cast<int>(std::clamp<long long>(wait.count(), 0, 100));
+            }
+            int n = ::epoll_wait(epfd, events, 256, timeoutMs);
+            if (n < 0 && errno != EINTR) {
+                std::perror("loadgen: epoll_wait");
+                ++tally.errors;
+                break;
+            }
+            now = Clock::now();
+
+            for (int i = 0; i < n; ++i) {
+                Player& p = *static_cast<Player*>(events[i].data.ptr);
+                ssize_t got;
+                while ((got = ::read(p.fd, buf, sizeof buf)) > 0) p.in.append(buf, static_cast<size_t>(got));
+                bool closed = got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+
+                size_t nl;
+                while ((nl = p.in.find('\n')) != std::string::npos) {
+                    p.in.erase(0, nl + 1);
+                    if (!p.waiting) {   // a reply nobody asked for
+                        ++tally.errors;
+                        continue;
+                    }
+                    tally.add(nsBetween(p.sentAt, now));
+                    p.waiting = false;
+                    if (++p.next == p.conversation->size()) {
+                        closed = false;
+                        begin(p);
+                        break;
+                    }
+                    idle.push_back(&p);
+                }
+                if (closed) {
+                    ++tally.errors;
+                    idle.erase(std::remove(idle.begin(), idle.end(), &p), idle.end());
+                    begin(p);
+                }
+            }
+
+            // Replies that never came
+            for (Player& p : players) {
+                if (p.waiting && now - p.sentAt > REPLY_TIMEOUT) {
+                    ++tally.errors;
+                    begin(p);
+                }
+            }
+        }
+
+        for (Player& p : players)
+            if (p.fd >= 0) ::close(p.fd);
+        ::close(epfd);
+    }
+
+#else
+
+    void runOverSocket(const std::string&, Plan&, size_t, Pacer, uint64_t, Tally& tally) {
+        std::fprintf(stderr, "loadgen: --connect needs Linux (epoll)\n");
+        ++tally.errors;
+    }
+
+#endif
+
+    // ─── Report ─────────────────────────────────────────────────
+
+    struct Summary {
+        double   seconds = 0;
+        Tally    tally;
+        Metrics::Snapshot engine;   // in process only
+        bool     inProcess = true;
+    };
+
+    // Percentiles are bucket ceilings; none can exceed what was seen
+    uint64_t quantileNs(const Tally& t, double q) { return std::min(t.latency.percentile(q), t.maxNs); }
+
+    void printReport(const Options& options, unsigned threads, const Summary& s) {
+        const uint64_t count = s.tally.latency.count;
+        std::printf("%s, %zu sessions on %u thread%s, ", s.inProcess ? "in process" : options.connect.c_str(),
+                    options.sessions, threads, threads == 1 ? "" : "s");
+        if (options.rate > 0)
+            std::printf("target %.0f messages/s\n", options.rate);
+        else
+            std::printf("unthrottled\n");
+        std::printf("messages: %llu in %.3f s = %.0f messages/s, errors: %llu\n",
+                    static_cast<unsigned long long>(count), s.seconds,
+                    s.seconds > 0 ? static_cast<double>(count) / s.seconds : 0.0,
+                    static_cast<unsigned long long>(s.tally.errors));
+        if (count == 0) return;
+
+        const Metrics::IntentStats& l = s.tally.latency;
+        std::printf("latency (us)       mean        p50        p90        p99       p999        max\n"
+                    "             %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                    static_cast<double>(l.sumNs) / static_cast<double>(count) / 1e3,
+                    static_cast<double>(quantileNs(s.tally, 0.50)) / 1e3, static_cast<double>(quantileNs(s.tally, 0.90)) / 1e3,
+                    static_cast<double>(quantileNs(s.tally, 0.99)) / 1e3, static_cast<double>(quantileNs(s.tally, 0.999)) / 1e3,
+                    static_cast<double>(s.tally.maxNs) / 1e3);
+
+        if (!s.inProcess) return;
+        std::printf("by intent          messages      share    p50 (us)   p99 (us)\n");
+        for (size_t i = 0; i < Metrics::INTENTS; ++i) {
+            const Metrics::IntentStats& st = s.engine.intents[i];
+            if (st.count == 0) continue;
+            std::printf("  %-14s %10llu %9.1f%% %11.2f %10.2f\n",
+                        std::string(intentName(static_cast<Intent>(i))).c_str(),
+                        static_cast<unsigned long long>(st.count),
+                        100.0 * static_cast<double>(st.count) / static_cast<double>(s.engine.total()),
+                        static_cast<double>(st.percentile(0.50)) / 1e3, static_cast<double>(st.percentile(0.99)) / 1e3);
+        }
+    }
+
+    bool writeJson(const std::string& path, const Options& options, unsigned threads, const Summary& s) {
+        std::FILE* f = std::fopen(path.c_str(), "w");
+        if (!f) {
+            std::perror(("loadgen: " + path).c_str());
+            return false;
+        }
+        const Metrics::IntentStats& l = s.tally.latency;
+        const uint64_t count = l.count;
+        std::fprintf(f,
+                     "{\n  \"format\": 1,\n  \"mode\": \"%s\",\n  \"sessions\": %zu,\n  \"threads\": %u,\n"
+                     "  \"target_rate\": %.1f,\n  \"seconds\": %.3f,\n  \"messages\": %llu,\n"
+                     "  \"messages_per_second\": %.1f,\n  \"errors\": %llu,\n",
+                     s.inProcess ? "in_process" : "socket", options.sessions, threads, options.rate, s.seconds,
+                     static_cast<unsigned long long>(count),
+                     s.seconds > 0 ? static_cast<double>(count) / s.seconds : 0.0,
+                     static_cast<unsigned long long>(s.tally.errors));
+        std::fprintf(f,
+                     "  \"latency_ns\": {\"mean\": %.1f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, "
+                     "\"p999\": %llu, \"max\": %llu}\n}\n",
+                     count ? static_cast<double>(l.sumNs) / static_cast<double>(count) : 0.0,
+                     static_cast<unsigned long long>(quantileNs(s.tally, 0.50)),
+                     static_cast<unsigned long long>(quantileNs(s.tally, 0.90)),
+                     static_cast<unsigned long long>(quantileNs(s.tally, 0.99)),
+                     static_cast<unsigned long long>(quantileNs(s.tally, 0.999)),
+                     static_cast<unsigned long long>(s.tally.maxNs));
+        return std::fclose(f) == 0;
+    }
+
+    void printUsage(std::FILE* out) {
+        std::fprintf(out,
+            "Usage: chat_loadgen [options]\n"
+            "  --replay FILE     play the conversations in FILE: a history log\n"
+            "                    (--history-log) or text, one message per line and a\n"
+            "                    blank line between conversations; may be repeated\n"
+            "  --synthetic N     play N generated conversations (the default, 1000,\n"
+            "                    when nothing is replayed)\n"
+            "  --connect ADDRESS drive a running `chatbot --serve` (PORT, HOST:PORT\n"
+            "                    or unix:/path) instead of the engine in process\n"
+            "  --kb FILE         in process: answer from a kbc-compiled image\n"
+            "  --sessions N      concurrent sessions (default: 64)\n"
+            "  --threads N       threads driving them (default: cores, at most N)\n"
+            "  --rate R          messages per second overall (default: as fast as possible)\n"
+            "  --duration S      run time in seconds (default: 10)\n"
+            "  --messages N      stop after N messages\n"
+            "  --seed N          seed the synthetic mix and the sessions\n"
+            "  --json FILE       also write the results as JSON\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--replay" && hasValue) {
+            options.replay.emplace_back(argv[++i]);
+        } else if (arg == "--synthetic" && hasValue) {
+            options.synthetic = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--connect" && hasValue) {
+            options.connect = argv[++i];
+        } else if (arg == "--kb" && hasValue) {
+            options.kbPath = argv[++i];
+        } else if (arg == "--sessions" && hasValue) {
+            options.sessions = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--rate" && hasValue) {
+            options.rate = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--duration" && hasValue) {
+            options.duration = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--messages" && hasValue) {
+            options.messages = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--json" && hasValue) {
+            options.jsonPath = argv[++i];
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(stdout);
+            return 0;
+        } else {
+            std::fprintf(stderr, "loadgen: unknown option '%s'\n", argv[i]);
+            printUsage(stderr);
+            return 2;
+        }
+    }
+    if (options.sessions == 0 || options.duration <= 0 || options.rate < 0) {
+        std::fprintf(stderr, "loadgen: --sessions, --duration and --rate must be positive\n");
+        return 2;
+    }
+
+    std::vector<Conversation> conversations;
+    for (const std::string& path : options.replay) {
+        std::string error;
+        if (!loadReplay(path, conversations, error)) {
+            std::fprintf(stderr, "loadgen: %s\n", error.c_str());
+            return 1;
+        }
+    }
+    if (options.synthetic == 0 && options.replay.empty()) options.synthetic = 1000;
+    if (options.synthetic > 0) {
+        std::vector<Conversation> generated =
+            syntheticConversations(options.synthetic, options.seed ? *options.seed : Util::randomSeed());
+        conversations.insert(conversations.end(), std::make_move_iterator(generated.begin()),
+                             std::make_move_iterator(generated.end()));
+    }
+    if (conversations.empty()) {
+        std::fprintf(stderr, "loadgen: no messages to play\n");
+        return 1;
+    }
+
+    size_t messageCount = 0;
+    for (const Conversation& c : conversations) messageCount += c.size();
+    std::printf("playing %zu conversations, %zu messages\n", conversations.size(), messageCount);
+
+    std::unique_ptr<KnowledgeStore> store;
+    if (options.connect.empty()) {
+        auto kb = std::make_unique<KnowledgeBase>();
+        std::string error;
+        if (!options.kbPath.empty() && !kb->load(options.kbPath, error)) {
+            std::fprintf(stderr, "loadgen: %s\n", error.c_str());
+            return 1;
+        }
+        store = std::make_unique<KnowledgeStore>(std::move(kb), options.kbPath);
+    }
+
+    unsigned threads = options.threads;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, options.sessions));
+
+    Plan plan;
+    plan.conversations = &conversations;
+    plan.seed  = options.seed;
+    plan.start = Clock::now();
+    plan.end   = plan.start + std::chrono::duration_cast<Clock::duration>(
+                                  std::chrono::duration<double>(options.duration));
+
+    std::vector<Tally> tallies(threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        size_t sessions = options.sessions / threads + (t < options.sessions % threads ? 1 : 0);
+        uint64_t quota = options.messages ? options.messages / threads + (t < options.messages % threads ? 1 : 0)
+                                          : UINT64_MAX;
+        Pacer pacer = makePacer(options, plan, threads);
+        pacer.next += pacer.interval * t / threads;   // stagger the threads' schedules
+        if (store)
+            workers.emplace_back(runInProcess, std::ref(*store), std::ref(plan), sessions, pacer, quota,
+                                 std::ref(tallies[t]));
+        else
+            workers.emplace_back(runOverSocket, std::cref(options.connect), std::ref(plan), sessions, pacer,
+                                 quota, std::ref(tallies[t]));
+    }
+    for (auto& w : workers) w.join();
+
+    Summary summary;
+    summary.seconds = std::chrono::duration<double>(Clock::now() - plan.start).count();
+    summary.inProcess = store != nullptr;
+    for (const Tally& t : tallies) summary.tally.merge(t);
+    if (store) summary.engine = Metrics::snapshot();
+
+    printReport(options, threads, summary);
+    if (!options.jsonPath.empty() && !writeJson(options.jsonPath, options, threads, summary)) return 1;
+    return summary.tally.errors == 0 ? 0 : 3;
+}
@@ -0,0 +1,98 @@
+/**
+ *  mapped_file.cpp — mmap on POSIX, whole-file read elsewhere
+ */
+
+#include "mapped_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHATBOT_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        data_      = std::exchange(other.data_, nullptr);
+        size_      = std::exchange(other.size_, 0);
+        mapped_    = std::exchange(other.mapped_, false);
+        fallback_  = std::move(other.fallback_);
+    }
+    return *this;
+}
+
+void MappedFile::close() {
+#ifdef CHATBOT_HAVE_MMAP
+    if (mapped_) ::munmap(const_cast<unsigned char*>(data_), size_);
+#endif
+    data_   = nullptr;
+    size_   = 0;
+    mapped_ = false;
+    fallback_.clear();
+    fallback_.shrink_to_fit();
+}
+
+bool MappedFile::open(const std::string& path, std::string& error) {
+    close();
+#ifdef CHATBOT_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) < 0) {
+        error = path + ": " + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        error = path + ": file is empty";
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int mapErrno = errno;
+    ::close(fd);   // the mapping keeps the file alive
+    if (addr == MAP_FAILED) {
+        error = path + ": mmap: " + std::strerror(mapErrno);
+        return false;
+    }
+
+    data_   = static_cast<const unsigned char*>(addr);
+    size_   = size;
+    mapped_ = true;
+    return true;
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        error = path + ": cannot open file";
+        return false;
+    }
+    fallback_.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    if (fallback_.empty() || !in.read(reinterpret_cast<char*>(fallback_.data()),
+                                      static_cast<std::streamsize>(fallback_.size()))) {
+        error = path + ": cannot read file";
+        fallback_.clear();
+        return false;
+    }
+    data_ = fallback_.data();
+    size_ = fallback_.size();
+    return true;
+#endif
+}
@@ -0,0 +1,38 @@
+/**
+ *  mapped_file.hpp — Read-only memory-mapped file
+ *
+ *  Pages are loaded lazily by the OS on first touch, so opening a file
+ *  costs the same no matter how large it is. Platforms without mmap
+ *  fall back to reading the whole file into memory.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps `path`; on failure returns false and describes why in `error`
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool isOpen() const { return data_ != nullptr; }
+
+private:
+    const unsigned char*       data_ = nullptr;
+    size_t                     size_ = 0;
+    bool                       mapped_ = false;
+    std::vector<unsigned char> fallback_;
+};
@@ -0,0 +1,123 @@
+/**
+ *  matcher.cpp — Aho-Corasick automaton construction and scanning
+ */
+
+#include "matcher.hpp"
+
+#include <algorithm>
+
+void KeyMatcher::build(const std::vector<std::string>& keys) {
+    // 1. Trie with unsorted child lists (fan-out is small)
+    std::vector<std::vector<std::pair<unsigned char, uint32_t>>> kids(1);
+    std::vector<uint32_t> termId(1, NO_MATCH);
+    std::vector<uint32_t> depth(1, 0);
+
+    for (size_t id = 0; id < keys.size(); ++id) {
+        uint32_t node = 0;
+        for (unsigned char c : keys[id]) {
+            uint32_t next = NO_MATCH;
+            for (const auto& [label, target] : kids[node])
+                if (label == c) { next = target; break; }
+            if (next == NO_MATCH) {
+                next = static_cast<uint32_t>(kids.size());
+                kids[node].emplace_back(c, next);
+                kids.emplace_back();
+                termId.push_back(NO_MATCH);
+                depth.push_back(depth[node] + 1);
+            }
+            node = next;
+        }
+        if (node != 0 && termId[node] == NO_MATCH)
+            termId[node] = static_cast<uint32_t>(id);
+    }
+
+    // 2. Flatten children into sorted CSR arrays
+    const size_t n = kids.size();
+    edgeBegin_.assign(n + 1, 0);
+    edgeLabel_.clear();
+    edgeTarget_.clear();
+    for (size_t s = 0; s < n; ++s) {
+        std::sort(kids[s].begin(), kids[s].end());
+        edgeBegin_[s] = static_cast<uint32_t>(edgeLabel_.size());
+        for (const auto& [label, target] : kids[s]) {
+            edgeLabel_.push_back(label);
+            edgeTarget_.push_back(target);
+        }
+    }
+    edgeBegin_[n] = static_cast<uint32_t>(edgeLabel_.size());
+
+    rootNext_.fill(0);
+    for (const auto& [label, target] : kids[0]) rootNext_[label] = target;
+
+    // 3. Failure links and best output, breadth-first so every
+    //    fail target is finished before it is read
+    fail_.assign(n, 0);
+    outLen_.assign(n, 0);
+    outId_.assign(n, NO_MATCH);
+
+    std::vector<uint32_t> queue;
+    queue.reserve(n);
+    for (const auto& kid : kids[0]) queue.push_back(kid.second);
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        uint32_t s = queue[head];
+        if (termId[s] != NO_MATCH) {
+            // A node's own key is longer than anything on its fail chain
+            outLen_[s] = depth[s];
+            outId_[s]  = termId[s];
+        } else {
+            outLen_[s] = outLen_[fail_[s]];
+            outId_[s]  = outId_[fail_[s]];
+        }
+        for (const auto& [label, target] : kids[s]) {
+            fail_[target] = step(fail_[s], label);
+            queue.push_back(target);
+        }
+    }
+}
+
+MatcherView KeyMatcher::view() const {
+    MatcherView v;
+    if (edgeBegin_.empty()) return v;   // never built: matches nothing
+    v.rootNext   = rootNext_.data();
+    v.edgeBegin  = edgeBegin_.data();
+    v.edgeLabel  = edgeLabel_.data();
+    v.edgeTarget = edgeTarget_.data();
+    v.fail       = fail_.data();
+    v.outLen     = outLen_.data();
+    v.outId      = outId_.data();
+    v.states     = static_cast<uint32_t>(fail_.size());
+    v.edges      = static_cast<uint32_t>(edgeLabel_.size());
+    return v;
+}
+
+uint32_t MatcherView::longestMatch(std::string_view text) const {
+    if (states == 0) return NO_MATCH;
+    uint32_t state = 0, bestLen = 0, bestId = NO_MATCH;
+    for (unsigned char c : text) {
+        state = step(state, c);
+        if (outLen[state] > bestLen) {
+            bestLen = outLen[state];
+            bestId  = outId[state];
+        }
+    }
+    return bestId;
+}
+
+uint32_t MatcherView::step(uint32_t state, unsigned char c) const {
+    // An out-of-range state reads as the root, and a fail chain longer
+    // than the automaton (a cycle) ends there
+    for (uint32_t hops = 0; state != 0 && state < states && hops < states; ++hops) {
+        const uint32_t end   = std::min(edgeBegin[state + 1], edges);
+        const uint32_t begin = std::min(edgeBegin[state], end);
+        const unsigned char* last = edgeLabel + end;
+        const unsigned char* it = std::lower_bound(edgeLabel + begin, last, c);
+        if (it != last && *it == c) {
+            const uint32_t next = edgeTarget[it - edgeLabel];
+            return next < states ? next : 0;
+        }
+        state = fail[state];
+    }
+    const uint32_t next = rootNext[c];
+    return next < states ? next : 0;
+}
@@ -0,0 +1,76 @@
+/**
+ *  matcher.hpp — Multi-pattern key matcher
+ *
+ *  Aho-Corasick automaton over every known key. A single pass over the
+ *  input reports the longest key it contains; ties go to the leftmost
+ *  occurrence, so the winner never depends on hash-map iteration order.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only automaton over flat arrays. The arrays are owned elsewhere —
+// by a KeyMatcher, or inside a compiled knowledge image (kb_image.hpp).
+// Given arrays of the right sizes, any contents are safe to scan: state
+// and edge numbers read from them are checked on use, so a damaged
+// image finds fewer matches but never reads outside its arrays.
+struct MatcherView {
+    const uint32_t*      rootNext   = nullptr;   // 256 entries
+    const uint32_t*      edgeBegin  = nullptr;   // states + 1
+    const unsigned char* edgeLabel  = nullptr;   // edges, sorted per state
+    const uint32_t*      edgeTarget = nullptr;   // edges
+    const uint32_t*      fail       = nullptr;   // states
+    const uint32_t*      outLen     = nullptr;   // states; longest key ending here
+    const uint32_t*      outId      = nullptr;   // states
+    uint32_t             states     = 0;
+    uint32_t             edges      = 0;
+
+    static constexpr uint32_t NO_MATCH = UINT32_MAX;
+
+    // Id of the longest key contained in `text`, or NO_MATCH.
+    uint32_t longestMatch(std::string_view text) const;
+
+private:
+    friend class KeyMatcher;   // reuses step() while computing fail links
+    uint32_t step(uint32_t state, unsigned char c) const;
+};
+
+// Builds (and owns) the automaton arrays for a set of keys.
+class KeyMatcher {
+public:
+    static constexpr uint32_t NO_MATCH = MatcherView::NO_MATCH;
+
+    // Rebuilds the automaton. The id of a key is its index in `keys`;
+    // duplicate keys keep the first id.
+    void build(const std::vector<std::string>& keys);
+
+    MatcherView view() const;
+
+    const std::array<uint32_t, 256>&  rootNext()   const { return rootNext_; }
+    const std::vector<uint32_t>&      edgeBegin()  const { return edgeBegin_; }
+    const std::vector<unsigned char>& edgeLabel()  const { return edgeLabel_; }
+    const std::vector<uint32_t>&      edgeTarget() const { return edgeTarget_; }
+    const std::vector<uint32_t>&      fail()       const { return fail_; }
+    const std::vector<uint32_t>&      outLen()     const { return outLen_; }
+    const std::vector<uint32_t>&      outId()      const { return outId_; }
+
+private:
+    // Dense transitions for the root, where most lookups restart
+    std::array<uint32_t, 256> rootNext_{};
+
+    // Sparse transitions for every other state (CSR, sorted by label)
+    std::vector<uint32_t>      edgeBegin_;
+    std::vector<unsigned char> edgeLabel_;
+    std::vector<uint32_t>      edgeTarget_;
+
+    std::vector<uint32_t> fail_;
+    std::vector<uint32_t> outLen_;
+    std::vector<uint32_t> outId_;
+
+    uint32_t step(uint32_t state, unsigned char c) const { return view().step(state, c); }
+};
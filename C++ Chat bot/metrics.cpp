@@ -0,0 +1,267 @@
+/**
+ *  metrics.cpp — Shard registry, aggregation and the metrics file
+ */
+
+#include "metrics.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Metrics {
+
+    namespace {
+
+        // One thread's counters, on cache lines of their own. Shards
+        // are recycled, never freed, so a reader can sum them at any time
+        // and the counts of exited threads stay in the totals.
+        struct alignas(64) Shard {
+            struct PerIntent {
+                std::atomic<uint64_t> count{0};
+                std::atomic<uint64_t> sumNs{0};
+                std::atomic<uint64_t> buckets[BUCKETS] = {};
+            };
+            PerIntent             intents[INTENTS];
+            std::atomic<uint64_t> cache[CACHE_EVENTS] = {};
+            std::atomic<bool>     owned{true};
+        };
+
+        std::mutex                          g_registryMutex;
+        std::vector<std::unique_ptr<Shard>> g_registry;
+
+        Shard* acquireShard() {
+            std::lock_guard<std::mutex> lock(g_registryMutex);
+            for (auto& shard : g_registry) {
+                bool free = false;
+                if (shard->owned.compare_exchange_strong(free, true)) return shard.get();
+            }
+            g_registry.push_back(std::make_unique<Shard>());
+            return g_registry.back().get();
+        }
+
+        // Hands the shard back when its thread exits
+        struct ShardHandle {
+            Shard* shard = acquireShard();
+            ~ShardHandle() { shard->owned.store(false, std::memory_order_release); }
+        };
+
+        Shard& localShard() {
+            thread_local ShardHandle handle;
+            return *handle.shard;
+        }
+
+        // Only the owning thread writes, so no read-modify-write is needed
+        inline void bump(std::atomic<uint64_t>& counter, uint64_t by) {
+            counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+        }
+
+        // Nanoseconds per now() tick, measured against steady_clock from
+        // a pair of readings taken at load time — two clock reads, no
+        // wait. The first record() fixes the ratio over however long the
+        // process has run by then, spinning only if that is still under
+        // MIN_CALIBRATION.
+#ifdef CHATBOT_HAVE_TSC
+        constexpr auto MIN_CALIBRATION = std::chrono::microseconds(200);
+
+        struct Anchor {
+            std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+            uint64_t ticks = now();
+        };
+        const Anchor g_anchor;
+
+        std::atomic<double> g_nsPerTick{0};
+
+        double nsPerTick() {
+            double ratio = g_nsPerTick.load(std::memory_order_relaxed);
+            if (ratio != 0) return ratio;
+
+            using Clock = std::chrono::steady_clock;
+            auto end = Clock::now();
+            while (end - g_anchor.time < MIN_CALIBRATION) end = Clock::now();
+            uint64_t ticks = now() - g_anchor.ticks;
+            double ns = static_cast<double>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - g_anchor.time).count());
+            ratio = ticks > 0 ? ns / static_cast<double>(ticks) : 1.0;
+            g_nsPerTick.store(ratio, std::memory_order_relaxed);   // racing threads store about the same
+            return ratio;
+        }
+#else
+        constexpr double nsPerTick() { return 1.0; }
+#endif
+
+        // Seconds from nanoseconds, without trailing noise
+        void appendSeconds(std::string& out, uint64_t ns) {
+            char buf[32];
+            std::snprintf(buf, sizeof buf, "%.9g", static_cast<double>(ns) / 1e9);
+            out += buf;
+        }
+    }
+
+    void record(Intent intent, uint64_t start) {
+        const uint64_t ticks = now() - start;   // before nsPerTick() may spin
+        auto ns = static_cast<uint64_t>(static_cast<double>(ticks) * nsPerTick());
+        Shard::PerIntent& s = localShard().intents[static_cast<size_t>(intent)];
+        bump(s.count, 1);
+        bump(s.sumNs, ns);
+        bump(s.buckets[bucketOf(ns)], 1);
+    }
+
+    void count(CacheEvent event) {
+        bump(localShard().cache[static_cast<size_t>(event)], 1);
+    }
+
+    // ─── Reading ────────────────────────────────────────────────
+
+    uint64_t IntentStats::percentile(double q) const {
+        uint64_t total = 0;
+        for (uint64_t n : buckets) total += n;   // not `count`: the sums may be a message apart
+        if (total == 0) return 0;
+
+        auto rank = static_cast<uint64_t>(q * static_cast<double>(total) + 0.5);
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) return bucketFloor(i + 1) - 1;
+        }
+        return bucketFloor(BUCKETS) - 1;
+    }
+
+    uint64_t Snapshot::total() const {
+        uint64_t n = 0;
+        for (const IntentStats& s : intents) n += s.count;
+        return n;
+    }
+
+    Snapshot snapshot() {
+        Snapshot result;
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        for (const auto& shard : g_registry) {
+            for (size_t i = 0; i < INTENTS; ++i) {
+                const Shard::PerIntent& from = shard->intents[i];
+                IntentStats& to = result.intents[i];
+                to.count += from.count.load(std::memory_order_relaxed);
+                to.sumNs += from.sumNs.load(std::memory_order_relaxed);
+                for (size_t b = 0; b < BUCKETS; ++b)
+                    to.buckets[b] += from.buckets[b].load(std::memory_order_relaxed);
+            }
+            for (size_t e = 0; e < CACHE_EVENTS; ++e)
+                result.cache[e] += shard->cache[e].load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    std::string prometheusText(const Snapshot& snapshot) {
+        // Exported buckets: every power of two from 128 ns to ~67 ms.
+        // They fall on histogram bucket edges, so the counts are exact.
+        constexpr unsigned FIRST_EDGE = 7, LAST_EDGE = 26;
+
+        std::string out;
+        out += "# HELP chatbot_messages_total Messages answered, by how they were resolved.\n"
+               "# TYPE chatbot_messages_total counter\n";
+        for (size_t i = 0; i < INTENTS; ++i) {
+            out += "chatbot_messages_total{intent=\"";
+            out += intentName(static_cast<Intent>(i));
+            out += "\"} ";
+            out += std::to_string(snapshot.intents[i].count);
+            out += '\n';
+        }
+
+        out += "# HELP chatbot_response_seconds Time to resolve one message, by intent.\n"
+               "# TYPE chatbot_response_seconds histogram\n";
+        for (size_t i = 0; i < INTENTS; ++i) {
+            const IntentStats& s = snapshot.intents[i];
+            std::string label = "intent=\"" + std::string(intentName(static_cast<Intent>(i))) + "\"";
+
+            uint64_t cumulative = 0;
+            size_t bucket = 0;
+            for (unsigned edge = FIRST_EDGE; edge <= LAST_EDGE; ++edge) {
+                uint64_t bound = uint64_t{1} << edge;
+                for (; bucket < BUCKETS && bucketFloor(bucket + 1) <= bound; ++bucket)
+                    cumulative += s.buckets[bucket];
+                out += "chatbot_response_seconds_bucket{" + label + ",le=\"";
+                appendSeconds(out, bound);
+                out += "\"} ";
+                out += std::to_string(cumulative);
+                out += '\n';
+            }
+            for (; bucket < BUCKETS; ++bucket) cumulative += s.buckets[bucket];
+            out += "chatbot_response_seconds_bucket{" + label + ",le=\"+Inf\"} ";
+            out += std::to_string(cumulative);
+            out += "\nchatbot_response_seconds_sum{" + label + "} ";
+            appendSeconds(out, s.sumNs);
+            out += "\nchatbot_response_seconds_count{" + label + "} ";
+            out += std::to_string(cumulative);
+            out += '\n';
+        }
+
+        static constexpr const char* CACHE_EVENT_NAMES[CACHE_EVENTS] = {"hit", "miss", "eviction"};
+        out += "# HELP chatbot_intent_cache_events_total Intent cache lookups (hit, miss) and replacements (eviction).\n"
+               "# TYPE chatbot_intent_cache_events_total counter\n";
+        for (size_t e = 0; e < CACHE_EVENTS; ++e) {
+            out += "chatbot_intent_cache_events_total{event=\"";
+            out += CACHE_EVENT_NAMES[e];
+            out += "\"} ";
+            out += std::to_string(snapshot.cache[e]);
+            out += '\n';
+        }
+        return out;
+    }
+
+    // ─── Metrics File ───────────────────────────────────────────
+
+    Exporter::~Exporter() {
+        if (!thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    bool Exporter::start(std::string path, std::chrono::seconds interval, std::string& error) {
+        path_ = std::move(path);
+        interval_ = interval.count() > 0 ? interval : std::chrono::seconds(1);
+        if (!write(error)) return false;
+        thread_ = std::thread(&Exporter::loop, this);
+        return true;
+    }
+
+    bool Exporter::write(std::string& error) const {
+        std::string text = prometheusText(snapshot());
+        std::string tmp = path_ + ".tmp";
+
+        std::FILE* file = std::fopen(tmp.c_str(), "w");
+        if (!file) {
+            error = tmp + ": " + std::strerror(errno);
+            return false;
+        }
+        bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok || std::rename(tmp.c_str(), path_.c_str()) != 0) {
+            error = path_ + ": " + std::strerror(errno);
+            std::remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    void Exporter::loop() {
+        bool failing = false;   // report a failure once, not every interval
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            bool stop = wake_.wait_for(lock, interval_, [this] { return stopping_; });
+
+            std::string error;
+            bool ok = write(error);
+            if (!ok && !failing)
+                std::fprintf(stderr, "chatbot: metrics file: %s\n", error.c_str());
+            failing = !ok;
+            if (stop) return;
+        }
+    }
+}
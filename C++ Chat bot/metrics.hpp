@@ -0,0 +1,158 @@
+/**
+ *  metrics.hpp — Per-intent message counters and latency histograms
+ *
+ *  Every thread records into its own shard: a message costs one load
+ *  and one store on each of three counters the thread alone writes — no
+ *  lock, no read-modify-write, no cache line shared with other threads.
+ *  Readers (the `stats` command, the metrics file) sum the shards with
+ *  relaxed loads; a message being recorded meanwhile may show up in
+ *  some of the sums and not yet in others.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "engine.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHATBOT_HAVE_TSC 1
+#include <x86intrin.h>
+#endif
+
+namespace Metrics {
+
+    // ── Histogram Layout ────────────────────────────────────────
+    // Log-linear, as in HdrHistogram: values below 8 ns get one bucket
+    // each, every power of two above is split into 8 equal buckets, so
+    // a reported value is within 12.5% of the recorded one.
+
+    inline constexpr unsigned SUB_BITS     = 3;
+    inline constexpr unsigned SUB_COUNT    = 1u << SUB_BITS;
+    inline constexpr unsigned MAX_EXPONENT = 39;   // 2^40 ns ≈ 18 min; slower clamps to the last bucket
+    inline constexpr size_t   BUCKETS      = (MAX_EXPONENT - SUB_BITS + 2) * SUB_COUNT;
+
+    constexpr size_t bucketOf(uint64_t ns) {
+        if (ns < SUB_COUNT) return static_cast<size_t>(ns);
+#if defined(__GNUC__)
+        auto exponent = static_cast<unsigned>(63 - __builtin_clzll(ns));
+#else
+        unsigned exponent = 63;
+        while (!(ns >> exponent)) --exponent;
+#endif
+        if (exponent > MAX_EXPONENT) return BUCKETS - 1;
+        size_t sub = static_cast<size_t>(ns >> (exponent - SUB_BITS)) & (SUB_COUNT - 1);
+        return (static_cast<size_t>(exponent - SUB_BITS + 1) << SUB_BITS) + sub;
+    }
+
+    // Smallest value that lands in `bucket`
+    constexpr uint64_t bucketFloor(size_t bucket) {
+        if (bucket < SUB_COUNT) return bucket;
+        unsigned exponent = static_cast<unsigned>(bucket >> SUB_BITS) + SUB_BITS - 1;
+        uint64_t sub = bucket & (SUB_COUNT - 1);
+        return (SUB_COUNT + sub) << (exponent - SUB_BITS);
+    }
+
+    static_assert(bucketOf(7) == 7 && bucketOf(8) == 8 && bucketOf(15) == 15);
+    static_assert(bucketOf(16) == 16 && bucketOf(17) == 16 && bucketOf(18) == 17);
+    static_assert(bucketFloor(bucketOf(1000)) <= 1000 && bucketFloor(bucketOf(1000) + 1) > 1000);
+    static_assert(bucketOf(UINT64_MAX) == BUCKETS - 1);
+
+    // ── Recording ───────────────────────────────────────────────
+
+    inline constexpr size_t INTENTS = static_cast<size_t>(Intent::Calculator) + 1;
+
+    // Timestamp for record(): the time-stamp counter where there is one
+    // (a few cycles to read, against tens of ns for steady_clock),
+    // nanoseconds of steady_clock elsewhere
+    inline uint64_t now() {
+#ifdef CHATBOT_HAVE_TSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    // Adds one message resolved as `intent`, begun at `start` (a now()
+    // reading), to the calling thread's shard. Wait-free after the
+    // thread's first call.
+    void record(Intent intent, uint64_t start);
+
+    // Intent cache lookups and replacements (intent_cache.hpp)
+    enum class CacheEvent : uint8_t { Hit, Miss, Eviction };
+    inline constexpr size_t CACHE_EVENTS = 3;
+
+    void count(CacheEvent event);
+
+    // ── Reading ─────────────────────────────────────────────────
+
+    struct IntentStats {
+        uint64_t count = 0;
+        uint64_t sumNs = 0;
+        std::array<uint64_t, BUCKETS> buckets{};
+
+        // Highest value of the bucket holding quantile `q` (0..1); 0 if empty
+        uint64_t percentile(double q) const;
+    };
+
+    struct Snapshot {
+        std::array<IntentStats, INTENTS> intents;
+        std::array<uint64_t, CACHE_EVENTS> cache{};
+
+        uint64_t operator[](CacheEvent event) const {
+            return cache[static_cast<size_t>(event)];
+        }
+
+        const IntentStats& operator[](Intent intent) const {
+            return intents[static_cast<size_t>(intent)];
+        }
+        uint64_t total() const;
+    };
+
+    // Sums every shard, including those of threads that have exited
+    Snapshot snapshot();
+
+    // Prometheus text exposition format: chatbot_messages_total and the
+    // chatbot_response_seconds histogram, both labelled by intent, and
+    // chatbot_intent_cache_events_total labelled by event
+    std::string prometheusText(const Snapshot& snapshot);
+
+    // ── Metrics File ────────────────────────────────────────────
+
+    // Rewrites a file with prometheusText() on a background thread, for
+    // a node_exporter textfile collector or anything else that scrapes
+    // files. Each write goes to "<path>.tmp" and is renamed over `path`,
+    // so readers never see a partial file.
+    class Exporter {
+    public:
+        Exporter() = default;
+        ~Exporter();   // writes once more, then stops
+
+        Exporter(const Exporter&) = delete;
+        Exporter& operator=(const Exporter&) = delete;
+
+        // Writes the file once (so a bad path fails here), then every
+        // `interval`. On failure `error` says why and nothing runs.
+        bool start(std::string path, std::chrono::seconds interval, std::string& error);
+
+    private:
+        std::string             path_;
+        std::chrono::seconds    interval_{0};
+        std::thread             thread_;
+        std::mutex              mutex_;
+        std::condition_variable wake_;
+        bool                    stopping_ = false;
+
+        bool write(std::string& error) const;
+        void loop();
+    };
+}
@@ -0,0 +1,78 @@
+/**
+ *  random.hpp — Per-session random numbers
+ *
+ *  xoshiro256** (Blackman & Vigna): 32 bytes of state and a few shifts,
+ *  rotates and multiplies per number. Every Session owns one, so sessions
+ *  share nothing and a session seeded with --seed replays exactly.
+ *  Bounded integers use Lemire's multiply-shift method: no modulo bias,
+ *  and a division only in the rare case a draw has to be rejected.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+class Random {
+public:
+    explicit Random(uint64_t seed) { reseed(seed); }
+
+    // The four state words come from splitmix64, so any seed (even 0)
+    // gives a well-mixed, non-zero state
+    void reseed(uint64_t seed) {
+        for (uint64_t& word : s_) {
+            seed += 0x9E3779B97F4A7C15u;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9u;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBu;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    // The four state words, to park a session and continue its
+    // sequence later; an all-zero state (never produced) reseeds
+    void save(uint64_t out[4]) const {
+        for (int i = 0; i < 4; ++i) out[i] = s_[i];
+    }
+    void restore(const uint64_t in[4]) {
+        for (int i = 0; i < 4; ++i) s_[i] = in[i];
+        if ((s_[0] | s_[1] | s_[2] | s_[3]) == 0) reseed(0);
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s_[1] * 5, 7) * 9;
+        uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, bound); bound must be non-zero
+    uint32_t below(uint32_t bound) {
+        uint64_t m = (next() >> 32) * bound;
+        auto low = static_cast<uint32_t>(m);
+        if (low < bound) {
+            uint32_t threshold = static_cast<uint32_t>(-bound) % bound;   // 2^32 mod bound
+            while (low < threshold) {
+                m = (next() >> 32) * bound;
+                low = static_cast<uint32_t>(m);
+            }
+        }
+        return static_cast<uint32_t>(m >> 32);
+    }
+
+    // Uniform in [min, max]
+    int between(int min, int max) {
+        auto span = static_cast<uint32_t>(static_cast<int64_t>(max) - min + 1);
+        uint32_t offset = span == 0 ? static_cast<uint32_t>(next() >> 32) : below(span);
+        return static_cast<int>(static_cast<int64_t>(min) + offset);
+    }
+
+private:
+    uint64_t s_[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
@@ -0,0 +1,80 @@
+/**
+ *  render.cpp — Buffered terminal output
+ */
+
+#include "render.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHATBOT_HAVE_WRITE 1
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr size_t SEPARATOR_WIDTH = 58;
+    constexpr size_t INITIAL_BUFFER  = 4096;
+}
+
+Renderer::Renderer(bool color) : color_(color) {
+    buf_.reserve(INITIAL_BUFFER);
+
+    if (color_) separator_.append(Ansi::DIM);
+    for (size_t i = 0; i < SEPARATOR_WIDTH; ++i) separator_.append("─");
+    if (color_) separator_.append(Ansi::RESET);
+    separator_ += '\n';
+}
+
+bool Renderer::stdoutIsTerminal() {
+#ifdef CHATBOT_HAVE_WRITE
+    return ::isatty(STDOUT_FILENO) == 1;
+#else
+    return true;
+#endif
+}
+
+Renderer& Renderer::number(size_t n, size_t width) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof digits, n);
+    size_t length = static_cast<size_t>(result.ptr - digits);
+    if (length < width) buf_.append(width - length, ' ');
+    buf_.append(digits, length);
+    return *this;
+}
+
+Renderer& Renderer::botSay(std::string_view msg) {
+    style(Ansi::CYAN_BOLD).text("  Bot ◂ ").style(Ansi::RESET);
+    size_t begin = 0;
+    while (true) {
+        size_t end = msg.find('\n', begin);
+        style(Ansi::WHITE).text(msg.substr(begin, end - begin)).style(Ansi::RESET).text('\n');
+        if (end == std::string_view::npos) break;
+        text("         ");
+        begin = end + 1;
+    }
+    return *this;
+}
+
+void Renderer::flush() {
+    if (buf_.empty()) return;
+#ifdef CHATBOT_HAVE_WRITE
+    // One call unless the terminal takes a partial write
+    const char* data = buf_.data();
+    size_t left = buf_.size();
+    while (left > 0) {
+        ssize_t n = ::write(STDOUT_FILENO, data, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;   // terminal gone; nothing sensible to do
+        }
+        data += n;
+        left -= static_cast<size_t>(n);
+    }
+#else
+    std::fwrite(buf_.data(), 1, buf_.size(), stdout);
+    std::fflush(stdout);
+#endif
+    buf_.clear();
+}
@@ -0,0 +1,81 @@
+/**
+ *  render.hpp — Terminal output for the interactive chat
+ *
+ *  A Renderer composes everything one turn prints (the reply, tables,
+ *  the next prompt) in a reusable buffer and hands it to the terminal
+ *  with a single write(). Escape sequences are precomputed byte strings;
+ *  with color off (--no-color, or stdout not a terminal) they are never
+ *  appended, so redirected output carries only the text.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// ─── ANSI Sequences ─────────────────────────────────────────────
+namespace Ansi {
+    inline constexpr std::string_view RESET   = "\033[0m";
+    inline constexpr std::string_view BOLD    = "\033[1m";
+    inline constexpr std::string_view DIM     = "\033[2m";
+
+    inline constexpr std::string_view GREEN   = "\033[32m";
+    inline constexpr std::string_view YELLOW  = "\033[33m";
+    inline constexpr std::string_view MAGENTA = "\033[35m";
+    inline constexpr std::string_view CYAN    = "\033[36m";
+    inline constexpr std::string_view WHITE   = "\033[37m";
+
+    inline constexpr std::string_view GREEN_BOLD   = "\033[32;1m";
+    inline constexpr std::string_view YELLOW_BOLD  = "\033[33;1m";
+    inline constexpr std::string_view MAGENTA_BOLD = "\033[35;1m";
+    inline constexpr std::string_view CYAN_BOLD    = "\033[36;1m";
+
+    inline constexpr std::string_view CLEAR_SCREEN = "\033[2J\033[H";
+}
+
+// ─── Renderer ───────────────────────────────────────────────────
+class Renderer {
+public:
+    explicit Renderer(bool color);
+
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
+    // False when stdout is redirected to a file, pipe or socket
+    static bool stdoutIsTerminal();
+
+    bool color() const { return color_; }
+
+    // Escape sequence; dropped entirely in no-color mode
+    Renderer& style(std::string_view ansi) {
+        if (color_) buf_.append(ansi);
+        return *this;
+    }
+    Renderer& text(std::string_view s) {
+        buf_.append(s);
+        return *this;
+    }
+    Renderer& text(char c) {
+        buf_ += c;
+        return *this;
+    }
+    // Decimal, right-aligned in `width` columns
+    Renderer& number(size_t n, size_t width = 0);
+
+    // Dim horizontal rule, composed once
+    Renderer& separator() { return text(separator_); }
+
+    // "  Bot ◂ " followed by `msg`; further lines are indented under the first
+    Renderer& botSay(std::string_view msg);
+
+    Renderer& clearScreen() { return style(Ansi::CLEAR_SCREEN); }
+
+    // Writes everything composed so far with one write() call
+    void flush();
+
+private:
+    bool        color_;
+    std::string buf_;         // reused for every turn
+    std::string separator_;
+};
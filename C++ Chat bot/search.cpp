@@ -0,0 +1,230 @@
+/**
+ *  search.cpp — Inverted index construction and top-1 retrieval
+ */
+
+#include "search.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace Search {
+
+    uint32_t hashTerm(std::string_view term) {
+        uint32_t h = 2166136261u;   // FNV-1a
+        for (unsigned char c : term) {
+            h ^= c;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    namespace {
+
+        // Anchors carry a little more than the weight a qualifying doc
+        // may leave unmatched, so float rounding cannot let a doc
+        // qualify without one
+        constexpr double ANCHOR_SHARE = 1.0 - MIN_COVERAGE + 1e-3;
+
+        void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+            while (v >= 0x80) {
+                out.push_back(static_cast<uint8_t>(v | 0x80));
+                v >>= 7;
+            }
+            out.push_back(static_cast<uint8_t>(v));
+        }
+
+        uint32_t getVarint(const uint8_t* bytes, uint32_t& at, uint32_t end) {
+            uint32_t v = 0;
+            for (unsigned shift = 0; at < end && shift < 35; shift += 7) {
+                uint8_t byte = bytes[at++];
+                v |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) break;
+            }
+            return v;
+        }
+    }
+
+    // ─── Building ───────────────────────────────────────────────
+
+    void IndexBuilder::build(const std::vector<std::string_view>& documents) {
+        *this = IndexBuilder{};
+        const size_t docs = documents.size();
+
+        // Term ids in order of first appearance; each doc's distinct
+        // term ids, sorted, in one flat list
+        std::unordered_map<std::string_view, uint32_t> ids;
+        std::vector<std::string_view> words;
+        std::vector<uint32_t> docFreq;
+        std::vector<uint32_t> termBegin{0}, termList;
+        std::vector<uint32_t> lengths(docs, 0);
+        uint64_t totalLength = 0;
+
+        for (uint32_t d = 0; d < docs; ++d) {
+            const size_t begin = termList.size();
+            forEachTerm(documents[d], [&](std::string_view word) {
+                auto [it, added] = ids.emplace(word, static_cast<uint32_t>(words.size()));
+                if (added) {
+                    words.push_back(word);
+                    docFreq.push_back(0);
+                }
+                termList.push_back(it->second);
+                ++lengths[d];
+            });
+            totalLength += lengths[d];
+            std::sort(termList.begin() + begin, termList.end());
+            termList.erase(std::unique(termList.begin() + begin, termList.end()), termList.end());
+            for (size_t i = begin; i < termList.size(); ++i) ++docFreq[termList[i]];
+            termBegin.push_back(static_cast<uint32_t>(termList.size()));
+        }
+
+        std::vector<float> idf(words.size());
+        for (size_t t = 0; t < words.size(); ++t) {
+            const double df = docFreq[t];
+            idf[t] = static_cast<float>(std::log(1.0 + (static_cast<double>(docs) - df + 0.5) / (df + 0.5)));
+        }
+
+        const float avgLength = docs ? static_cast<float>(totalLength) / static_cast<float>(docs) : 1.0f;
+        docNorm_.resize(docs);
+        docWeight_.resize(docs);
+        docBegin_.reserve(docs + 1);
+        std::vector<std::vector<uint32_t>> anchored(words.size());
+        std::vector<float> maxScore(words.size(), 0.0f);
+        std::vector<uint32_t> byWeight;
+
+        for (uint32_t d = 0; d < docs; ++d) {
+            float relative = avgLength > 0 ? static_cast<float>(lengths[d]) / avgLength : 1.0f;
+            docNorm_[d] = (K1 + 1) / (1 + K1 * (1 - B + B * relative));
+
+            // Summed in term id order, as best() sums matches
+            float weight = 0;
+            uint32_t prev = 0;
+            docBegin_.push_back(static_cast<uint32_t>(docTerms_.size()));
+            for (uint32_t i = termBegin[d]; i < termBegin[d + 1]; ++i) {
+                weight += idf[termList[i]];
+                putVarint(docTerms_, termList[i] - prev);
+                prev = termList[i];
+            }
+            docWeight_[d] = weight;
+
+            byWeight.assign(termList.begin() + termBegin[d], termList.begin() + termBegin[d + 1]);
+            std::sort(byWeight.begin(), byWeight.end(), [&](uint32_t a, uint32_t b) {
+                return idf[a] != idf[b] ? idf[a] > idf[b] : a < b;
+            });
+            double carried = 0;
+            for (uint32_t t : byWeight) {
+                anchored[t].push_back(d);
+                maxScore[t] = std::max(maxScore[t], docNorm_[d] * weight);
+                carried += idf[t];
+                if (carried > ANCHOR_SHARE * weight) break;
+            }
+        }
+        docBegin_.push_back(static_cast<uint32_t>(docTerms_.size()));
+
+        for (uint32_t t = 0; t < words.size(); ++t) {
+            terms_.push_back({static_cast<uint32_t>(text_.size()), static_cast<uint32_t>(words[t].size()),
+                              static_cast<uint32_t>(postings_.size()), idf[t], maxScore[t]});
+            text_.append(words[t]);
+            uint32_t prev = 0;
+            for (uint32_t d : anchored[t]) {
+                putVarint(postings_, d - prev);
+                prev = d;
+            }
+        }
+        terms_.push_back({static_cast<uint32_t>(text_.size()), 0, static_cast<uint32_t>(postings_.size()), 0.0f, 0.0f});
+
+        // Term lookup table, at most half full
+        size_t slots = 8;
+        while (slots < words.size() * 2) slots <<= 1;
+        slots_.assign(slots, 0);
+        for (uint32_t t = 0; t < words.size(); ++t) {
+            size_t i = hashTerm(words[t]) & (slots - 1);
+            while (slots_[i] != 0) i = (i + 1) & (slots - 1);
+            slots_[i] = t + 1;
+        }
+    }
+
+    // ─── Reading ────────────────────────────────────────────────
+
+    uint32_t IndexView::findTerm(std::string_view term) const {
+        if (slotCount == 0) return NO_MATCH;
+        const uint32_t mask = slotCount - 1;
+        for (uint32_t i = hashTerm(term) & mask, probes = 0; slots[i] != 0 && probes <= mask;
+             i = (i + 1) & mask, ++probes) {
+            uint32_t id = slots[i] - 1;
+            if (id >= termCount) return NO_MATCH;
+            const Term& t = terms[id];
+            if (uint64_t{t.text} + t.length <= textSize &&
+                std::string_view(text + t.text, t.length) == term)
+                return id;
+        }
+        return NO_MATCH;
+    }
+
+    uint32_t IndexView::best(std::string_view query) const {
+        if (termCount == 0 || docCount == 0) return NO_MATCH;
+
+        uint32_t ids[MAX_QUERY_TERMS];
+        size_t n = 0;
+        forEachTerm(query, [&](std::string_view word) {
+            if (n == MAX_QUERY_TERMS) return;
+            uint32_t id = findTerm(word);
+            if (id != NO_MATCH && std::find(ids, ids + n, id) == ids + n) ids[n++] = id;
+        });
+        if (n < MIN_MATCHED_TERMS) return NO_MATCH;
+
+        // In term id order, to walk alongside the docs' term lists; sums
+        // then round the same way as the doc weights
+        std::sort(ids, ids + n);
+        float queryWeight = 0;
+        for (size_t i = 0; i < n; ++i) queryWeight += terms[ids[i]].idf;
+
+        // Lists with the highest bound first: a good match found early
+        // lets whole lists of common words be skipped
+        uint32_t order[MAX_QUERY_TERMS];
+        std::copy(ids, ids + n, order);
+        std::sort(order, order + n, [&](uint32_t a, uint32_t b) { return terms[a].maxScore > terms[b].maxScore; });
+
+        float threshold = 0;
+        uint32_t bestDoc = NO_MATCH;
+        for (size_t i = 0; i < n; ++i) {
+            const Term& t = terms[order[i]];
+            if (t.maxScore < threshold) break;
+
+            uint32_t at = std::min(t.postings, postingsSize);
+            const uint32_t listEnd = std::min(terms[order[i] + 1].postings, postingsSize);
+            for (uint32_t doc = 0; at < listEnd;) {
+                doc += getVarint(postings, at, listEnd);
+                if (doc >= docCount) break;
+
+                // A doc can match at most the lighter of its words and
+                // the input's; most candidates stop here. A doc anchored
+                // by several of the words is scored once per list, to the
+                // same result.
+                if (docNorm[doc] * std::min(queryWeight, docWeight[doc]) < threshold) continue;
+
+                float idfSum = 0;
+                unsigned matched = 0;
+                uint32_t pos = docBegin[doc], end = std::min(docBegin[doc + 1], docTermsSize);
+                uint32_t term = 0;
+                size_t q = 0;
+                while (pos < end && q < n) {
+                    term += getVarint(docTerms, pos, end);
+                    while (q < n && ids[q] < term) ++q;
+                    if (q < n && ids[q] == term) {
+                        idfSum += terms[term].idf;
+                        ++matched;
+                        ++q;
+                    }
+                }
+                float score = docNorm[doc] * idfSum;
+                if (matched >= MIN_MATCHED_TERMS && idfSum >= MIN_COVERAGE * docWeight[doc] &&
+                    (score > threshold || (score == threshold && doc < bestDoc))) {
+                    threshold = score;
+                    bestDoc = doc;
+                }
+            }
+        }
+        return bestDoc;
+    }
+}
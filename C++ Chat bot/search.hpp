@@ -0,0 +1,129 @@
+/**
+ *  search.hpp — Word-level retrieval over knowledge keys
+ *
+ *  An inverted index for free-form questions that neither equal nor
+ *  contain a key ("can you tell me what c++ is" → "what is c++?"). Every
+ *  key is a document of words, ranked against the input by BM25.
+ *
+ *  A key only qualifies if the input covers most of what makes it
+ *  specific: at least MIN_MATCHED_TERMS of its words, carrying at least
+ *  MIN_COVERAGE of its total IDF weight. So a key cannot qualify without
+ *  one of its heaviest words — the shortest run, by descending IDF, that
+ *  carries more than the rest may leave out. Those are its anchors, and
+ *  a word's posting list names only the keys it anchors: "what" and "is"
+ *  anchor almost nothing, so a question full of them still touches few
+ *  candidates. The input's anchor lists are read best bound first, and
+ *  each candidate is scored against its own list of words — unless its
+ *  best possible score cannot beat the best one so far, and a whole
+ *  list is skipped once none of its keys can (as in MaxScore).
+ *
+ *  Both kinds of list are delta + varint coded.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Search {
+
+    inline constexpr size_t   MAX_QUERY_TERMS   = 32;     // further words are ignored
+    inline constexpr unsigned MIN_MATCHED_TERMS = 2;
+    inline constexpr float    MIN_COVERAGE      = 0.75f;
+
+    // BM25 parameters (the usual defaults)
+    inline constexpr float K1 = 1.2f;
+    inline constexpr float B  = 0.75f;
+
+    // Words are runs of letters, digits, UTF-8 bytes and the characters
+    // that make "c++", "c#" and "what's" words of their own; anything
+    // else separates them. Input is expected to be lowercased already.
+    constexpr bool isWordByte(unsigned char c) {
+        return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80 ||
+               c == '+' || c == '#' || c == '\'';
+    }
+
+    template <typename Fn>
+    void forEachTerm(std::string_view text, Fn&& fn) {
+        size_t i = 0;
+        while (i < text.size()) {
+            while (i < text.size() && !isWordByte(static_cast<unsigned char>(text[i]))) ++i;
+            size_t begin = i;
+            while (i < text.size() && isWordByte(static_cast<unsigned char>(text[i]))) ++i;
+            if (i > begin) fn(text.substr(begin, i - begin));
+        }
+    }
+
+    uint32_t hashTerm(std::string_view term);
+
+    // ── Index records ───────────────────────────────────────────
+
+    struct Term {
+        uint32_t text;         // offset into the term text
+        uint32_t length;
+        uint32_t postings;     // anchor list: [postings, next term's postings)
+        float    idf;
+        float    maxScore;     // highest docNorm · docWeight among the keys it anchors
+    };
+
+    // ── Building ────────────────────────────────────────────────
+
+    // Builds (and owns) the index arrays over `documents`; the id of a
+    // document is its index.
+    class IndexBuilder {
+    public:
+        void build(const std::vector<std::string_view>& documents);
+
+        const std::vector<Term>&     terms()        const { return terms_; }         // + sentinel
+        const std::vector<uint32_t>& slots()        const { return slots_; }         // term id + 1, 0 = empty
+        const std::string&           text()         const { return text_; }
+        const std::vector<uint8_t>&  postings()     const { return postings_; }
+        const std::vector<uint32_t>& docBegin()     const { return docBegin_; }      // docs + 1
+        const std::vector<uint8_t>&  docTerms()     const { return docTerms_; }
+        const std::vector<float>&    docNorm()      const { return docNorm_; }
+        const std::vector<float>&    docWeight()    const { return docWeight_; }
+
+    private:
+        std::vector<Term>     terms_;
+        std::vector<uint32_t> slots_;
+        std::string           text_;
+        std::vector<uint8_t>  postings_;       // doc id deltas
+        std::vector<uint32_t> docBegin_;
+        std::vector<uint8_t>  docTerms_;       // per doc, its distinct term ids as deltas
+        std::vector<float>    docNorm_;        // BM25 length factor (k1 + 1) / (1 + k1 (1 - b + b·len/avg))
+        std::vector<float>    docWeight_;      // sum of the IDF of the doc's distinct words
+    };
+
+    // ── Reading ─────────────────────────────────────────────────
+
+    // Read-only index over flat arrays owned elsewhere — by an
+    // IndexBuilder, or inside a compiled knowledge image.
+    struct IndexView {
+        const Term*     terms        = nullptr;   // termCount + 1
+        const uint32_t* slots        = nullptr;   // slotCount, a power of two
+        const char*     text         = nullptr;
+        const uint8_t*  postings     = nullptr;
+        const uint32_t* docBegin     = nullptr;   // docCount + 1
+        const uint8_t*  docTerms     = nullptr;
+        const float*    docNorm      = nullptr;   // docCount
+        const float*    docWeight    = nullptr;   // docCount
+        uint32_t termCount    = 0;
+        uint32_t slotCount    = 0;
+        uint32_t textSize     = 0;
+        uint32_t postingsSize = 0;
+        uint32_t docTermsSize = 0;
+        uint32_t docCount     = 0;
+
+        static constexpr uint32_t NO_MATCH = UINT32_MAX;
+
+        // Highest-scoring qualifying document for `query`, or NO_MATCH;
+        // ties go to the lowest id
+        uint32_t best(std::string_view query) const;
+
+    private:
+        uint32_t findTerm(std::string_view term) const;
+    };
+}
@@ -0,0 +1,559 @@
+/**
+ *  server.cpp — epoll event loops serving many sessions per thread
+ *
+ *  Every worker thread owns an epoll instance. All workers watch the
+ *  shared listening socket with EPOLLEXCLUSIVE, so each new connection
+ *  wakes one worker, which accepts it and then owns it for its whole
+ *  life — session state is never touched by two threads. The knowledge
+ *  base is shared read-only and pinned per message, so a reload never
+ *  stalls a worker; a connection carries only its Session and two small
+ *  I/O buffers.
+ *
+ *  Nothing ever blocks on one session: its dialogue (welcome, chat,
+ *  calculator) is a state machine in the Session that each complete
+ *  line advances, so a worker interleaves sessions in every stage.
+ *  Connection frames come from a per-worker pool and go back to it on
+ *  close, so a worker stops allocating once it has seen its peak load.
+ *
+ *  Named sessions outlive their connection: every message is recorded
+ *  in the shared SnapshotStore, and a closed connection parks its
+ *  session there for whichever worker the client reconnects to.
+ */
+
+#include "server.hpp"
+
+#include <cstdio>
+
+#include "engine.hpp"
+#include "kb_store.hpp"
+#include "snapshot.hpp"
+#include "util.hpp"
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+    constexpr size_t MAX_LINE_BYTES     = 4096;      // longer lines end the session
+    constexpr size_t MAX_PENDING_OUTPUT = 1 << 20;   // stop reading until the peer drains
+    constexpr size_t READ_CHUNK         = 16384;
+    constexpr int    MAX_EVENTS         = 256;
+    constexpr unsigned MAX_DEFAULT_WORKERS = 4;
+    constexpr size_t   FRAMES_PER_SLAB     = 64;
+    constexpr size_t   KEEP_BUFFER_BYTES   = 2 * READ_CHUNK;  // larger buffers are freed on close
+
+    std::atomic<uint64_t> g_sessions{0};   // sessions accepted so far, by every worker
+
+    int g_stopFd = -1;   // eventfd raised by SIGINT/SIGTERM, watched by every worker
+
+    void onStopSignal(int) {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(g_stopFd, &one, sizeof one);
+        (void)ignored;
+    }
+
+    // ─── Listening Socket ───────────────────────────────────────
+
+    struct Listener {
+        int         fd = -1;
+        std::string unixPath;   // removed again on shutdown
+    };
+
+    bool listenUnix(const std::string& path, Listener& out) {
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) {
+            std::fprintf(stderr, "chatbot: socket path too long: %s\n", path.c_str());
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        // Replace a stale socket from a previous run, never a regular file
+        struct stat st{};
+        if (::stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) ::unlink(path.c_str());
+
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0 ||
+            ::listen(fd, SOMAXCONN) < 0) {
+            std::perror(("chatbot: " + path).c_str());
+            if (fd >= 0) ::close(fd);
+            return false;
+        }
+        out.fd = fd;
+        out.unixPath = path;
+        return true;
+    }
+
+    bool listenTcp(const std::string& address, Listener& out) {
+        std::string host = "127.0.0.1", port = address;
+        auto colon = address.rfind(':');
+        if (colon != std::string::npos) {
+            host = address.substr(0, colon);
+            port = address.substr(colon + 1);
+            if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+                host = host.substr(1, host.size() - 2);
+        }
+
+        addrinfo hints{};
+        hints.ai_family   = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags    = AI_PASSIVE;
+        addrinfo* res = nullptr;
+        int rc = ::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &res);
+        if (rc != 0) {
+            std::fprintf(stderr, "chatbot: cannot resolve '%s': %s\n", address.c_str(), gai_strerror(rc));
+            return false;
+        }
+
+        int fd = -1;
+        for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+            fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd < 0) continue;
+            int on = 1;
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+            if (::bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && ::listen(fd, SOMAXCONN) == 0) break;
+            ::close(fd);
+            fd = -1;
+        }
+        ::freeaddrinfo(res);
+
+        if (fd < 0) {
+            std::perror(("chatbot: " + address).c_str());
+            return false;
+        }
+        out.fd = fd;
+        return true;
+    }
+
+    // ─── Worker ─────────────────────────────────────────────────
+
+    struct Connection {
+        int         fd;
+        Session     session;
+        std::string in;              // bytes after the last complete line
+        std::string out;             // replies the socket has not taken yet
+        size_t      outPos  = 0;
+        uint32_t    events  = 0;     // current epoll interest
+        bool        closing = false; // close once `out` is flushed
+        bool        broken  = false; // peer gone; drop without flushing
+        bool        fresh   = true;  // no message yet, so it may still be named
+        bool        ended   = false; // said bye: not parked
+        std::string name;            // "" = anonymous, see server.hpp
+        uint64_t    cursor  = 0;     // newest snapshot record of a named session
+    };
+
+    // Connection frames in slabs of FRAMES_PER_SLAB, recycled through a
+    // free list. A recycled frame keeps its session's history arena and
+    // its buffers (unless they grew past KEEP_BUFFER_BYTES).
+    class ConnectionPool {
+    public:
+        // A frame in its initial state, apart from the session's settings
+        Connection* acquire(int fd) {
+            if (free_.empty()) {
+                slabs_.push_back(std::make_unique<Connection[]>(FRAMES_PER_SLAB));
+                Connection* slab = slabs_.back().get();
+                for (size_t i = FRAMES_PER_SLAB; i > 0; --i) free_.push_back(&slab[i - 1]);
+            }
+            Connection* conn = free_.back();
+            free_.pop_back();
+            conn->fd = fd;
+            conn->session.reset();
+            conn->in.clear();
+            conn->out.clear();
+            conn->outPos  = 0;
+            conn->events  = 0;
+            conn->closing = false;
+            conn->broken  = false;
+            conn->fresh   = true;
+            conn->ended   = false;
+            conn->name.clear();
+            conn->cursor  = 0;
+            return conn;
+        }
+
+        void release(Connection* conn) {
+            if (conn->in.capacity() > KEEP_BUFFER_BYTES) std::string().swap(conn->in);
+            if (conn->out.capacity() > KEEP_BUFFER_BYTES) std::string().swap(conn->out);
+            free_.push_back(conn);
+        }
+
+    private:
+        std::vector<std::unique_ptr<Connection[]>> slabs_;
+        std::vector<Connection*>                   free_;
+    };
+
+    class Worker {
+    public:
+        Worker(KnowledgeStore& store, SnapshotStore* snapshots, int listenFd, bool tcp,
+               const ServerOptions& options)
+            : store_(store), reader_(store), snapshots_(snapshots), listenFd_(listenFd), tcp_(tcp),
+              options_(options) {}
+
+        ~Worker() {
+            for (auto& [fd, conn] : connections_) {
+                park(*conn);
+                ::close(fd);
+            }
+            if (epfd_ >= 0) ::close(epfd_);
+        }
+
+        // `error` is set for log failures; epoll failures leave it empty, see errno
+        bool init(const std::string& historyLog, std::string& error) {
+            if (!historyLog.empty() && !log_.open(historyLog, error)) return false;
+
+            epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+            if (epfd_ < 0) return false;
+
+            epoll_event ev{};
+            ev.events   = EPOLLIN | EPOLLEXCLUSIVE;
+            ev.data.ptr = &listenTag_;
+            if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, listenFd_, &ev) < 0) return false;
+
+            ev.events   = EPOLLIN;   // never read, so it stays ready for every worker
+            ev.data.ptr = &stopTag_;
+            return ::epoll_ctl(epfd_, EPOLL_CTL_ADD, g_stopFd, &ev) == 0;
+        }
+
+        void run() {
+            epoll_event events[MAX_EVENTS];
+            bool stopping = false;
+            while (!stopping) {
+                int n = ::epoll_wait(epfd_, events, MAX_EVENTS, -1);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    std::perror("chatbot: epoll_wait");
+                    return;
+                }
+                for (int i = 0; i < n; ++i) {
+                    void* tag = events[i].data.ptr;
+                    if (tag == &listenTag_)
+                        acceptAll();
+                    else if (tag == &stopTag_)
+                        stopping = true;
+                    else
+                        handle(*static_cast<Connection*>(tag), events[i].events);
+                }
+                log_.flush();   // one write for the whole batch
+                if (snapshots_) snapshots_->flush();
+            }
+        }
+
+    private:
+        KnowledgeStore&        store_;
+        KnowledgeStore::Reader reader_;
+        SnapshotStore*         snapshots_;   // shared by every worker; null without --snapshots
+        int  listenFd_;
+        bool tcp_;
+        const ServerOptions& options_;
+        int  epfd_ = -1;
+        char listenTag_ = 0, stopTag_ = 0;   // addresses identify the special fds
+        ConnectionPool pool_;
+        std::unordered_map<int, Connection*> connections_;
+        HistoryLog log_;                     // this worker's sessions only
+        std::string line_;                   // scratch for one message
+
+        void acceptAll() {
+            while (true) {
+                int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) {
+                    if (errno == EINTR) continue;
+                    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED)
+                        std::perror("chatbot: accept");
+                    return;
+                }
+                if (tcp_) {
+                    int on = 1;
+                    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+                }
+
+                Connection* conn = pool_.acquire(fd);
+                conn->session.fuzzyDistance = options_.fuzzyDistance;
+                uint64_t ordinal = g_sessions.fetch_add(1, std::memory_order_relaxed);
+                if (options_.seed) conn->session.random.reseed(*options_.seed + ordinal);
+                if (log_.isOpen()) conn->session.history.attachLog(&log_);
+                if (options_.welcome) {
+                    conn->session.stage = Stage::Welcome;
+                    conn->out.append(pendingQuestion(conn->session)).append("\n");
+                }
+                conn->events = EPOLLIN;
+                if (!conn->out.empty()) conn->events |= EPOLLOUT;
+
+                epoll_event ev{};
+                ev.events   = conn->events;
+                ev.data.ptr = conn;
+                if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                    ::close(fd);
+                    pool_.release(conn);
+                    continue;
+                }
+                connections_.emplace(fd, conn);
+            }
+        }
+
+        void handle(Connection& conn, uint32_t events) {
+            if (events & EPOLLERR) conn.broken = true;
+            if (!conn.broken && (events & EPOLLHUP)) {
+                // The peer is gone, but what it sent before hanging up is
+                // still answered — for the history, log and snapshots —
+                // with the replies thrown away
+                if (events & EPOLLIN) readInput(conn, true);
+                conn.broken = true;
+            }
+            if (!conn.broken && (events & EPOLLIN)) readInput(conn, false);
+            if (!conn.broken) flushOutput(conn);
+
+            if (conn.broken || (conn.closing && conn.outPos == conn.out.size())) {
+                closeConnection(conn.fd);
+                return;
+            }
+            updateInterest(conn);
+        }
+
+        // Reads and answers what is buffered; with `hungUp`, to the end
+        // regardless of unsent output, which is discarded
+        void readInput(Connection& conn, bool hungUp) {
+            char buf[READ_CHUNK];
+            while (!conn.closing && (hungUp || conn.out.size() - conn.outPos < MAX_PENDING_OUTPUT)) {
+                ssize_t n = ::read(conn.fd, buf, sizeof buf);
+                if (n > 0) {
+                    conn.in.append(buf, static_cast<size_t>(n));
+                    processLines(conn);
+                    if (hungUp) {
+                        conn.out.clear();
+                        conn.outPos = 0;
+                    }
+                    continue;
+                }
+                if (n == 0) {                 // peer finished sending
+                    if (!conn.in.empty()) {
+                        std::string last = std::move(conn.in);
+                        conn.in.clear();
+                        processMessage(conn, last);
+                    }
+                    conn.closing = true;
+                    return;
+                }
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) conn.broken = true;
+                return;
+            }
+        }
+
+        void processLines(Connection& conn) {
+            size_t begin = 0;
+            while (!conn.closing) {
+                size_t nl = conn.in.find('\n', begin);
+                if (nl == std::string::npos) break;
+                line_.assign(conn.in, begin, nl - begin);
+                begin = nl + 1;
+                processMessage(conn, line_);
+            }
+            conn.in.erase(0, begin);
+
+            if (!conn.closing && conn.in.size() > MAX_LINE_BYTES) {
+                conn.out += "Message too long — closing the session.\n";
+                conn.closing = true;
+            }
+        }
+
+        // `input` is normalized in place
+        void processMessage(Connection& conn, std::string& input) {
+            if (conn.fresh && nameSession(conn, input)) return;
+            Util::normalizeInPlace(input);
+            if (input.empty()) return;
+            conn.fresh = false;
+
+            const size_t logged = conn.session.history.total();
+            Response reply;
+            {
+                auto kb = reader_.pin();
+                reply = respond(*kb, conn.session, input);
+            }
+            if (reply.has(Response::Reload)) store_.requestReload();
+            appendPlainLine(conn.out, reply);
+            if (reply.has(Response::EndSession)) conn.closing = conn.ended = true;
+
+            if (!conn.name.empty()) {
+                std::string_view message;
+                if (conn.session.history.total() != logged) message = input;
+                snapshots_->record(conn.name, conn.session, message, conn.cursor);
+            }
+        }
+
+        // "@session NAME" as the first line resumes or starts the
+        // session named NAME; false if `line` is anything else
+        bool nameSession(Connection& conn, std::string_view line) {
+            line = Util::trim(line);
+            if (line != "@session" && !Util::startsWith(line, "@session ")) return false;
+            std::string_view name = Util::trim(line.substr(8));
+            conn.fresh = false;
+
+            if (!snapshots_) {
+                conn.out += "Sessions are not kept by this server.\n";
+                return true;
+            }
+            if (!SnapshotStore::validName(name)) {
+                conn.out += "Session names are 1-64 letters, digits, '.', '_', ':' or '-'.\n";
+                return true;
+            }
+            switch (snapshots_->attach(name, conn.session, conn.cursor)) {
+                case SnapshotStore::Attach::InUse:
+                    conn.out.append("Session ").append(name).append(" is open on another connection.\n");
+                    conn.closing = true;
+                    return true;
+                case SnapshotStore::Attach::Resumed:
+                    conn.out.append("Welcome back! Resumed session ").append(name).append(" after ")
+                        .append(std::to_string(conn.session.messageCount))
+                        .append(conn.session.messageCount == 1 ? " message." : " messages.");
+                    break;
+                case SnapshotStore::Attach::Started:
+                    conn.out.append("Started session ").append(name).append(".");
+                    break;
+            }
+            conn.name.assign(name);
+            std::string_view question = pendingQuestion(conn.session);
+            if (!question.empty()) conn.out.append(" ").append(question);
+            conn.out += '\n';
+            return true;
+        }
+
+        // A named session is kept for a later "@session NAME" unless it ended
+        void park(Connection& conn) {
+            if (!conn.name.empty()) snapshots_->detach(conn.name, conn.cursor, conn.ended);
+            conn.name.clear();
+        }
+
+        void flushOutput(Connection& conn) {
+            while (conn.outPos < conn.out.size()) {
+                ssize_t n = ::send(conn.fd, conn.out.data() + conn.outPos,
+                                   conn.out.size() - conn.outPos, MSG_NOSIGNAL);
+                if (n > 0) {
+                    conn.outPos += static_cast<size_t>(n);
+                    continue;
+                }
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) conn.broken = true;
+                return;
+            }
+            conn.out.clear();
+            conn.outPos = 0;
+        }
+
+        void updateInterest(Connection& conn) {
+            bool pending = conn.outPos < conn.out.size();
+            uint32_t want = 0;
+            if (pending) want |= EPOLLOUT;
+            if (!conn.closing && conn.out.size() - conn.outPos < MAX_PENDING_OUTPUT) want |= EPOLLIN;
+            if (want == conn.events) return;
+
+            epoll_event ev{};
+            ev.events   = want;
+            ev.data.ptr = &conn;
+            ::epoll_ctl(epfd_, EPOLL_CTL_MOD, conn.fd, &ev);
+            conn.events = want;
+        }
+
+        void closeConnection(int fd) {
+            ::epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+            ::close(fd);
+            auto it = connections_.find(fd);
+            park(*it->second);
+            pool_.release(it->second);
+            connections_.erase(it);
+        }
+    };
+}
+
+int runServer(KnowledgeStore& store, const ServerOptions& options) {
+    Listener listener;
+    const std::string unixPrefix = "unix:";
+    bool tcp = options.address.compare(0, unixPrefix.size(), unixPrefix) != 0;
+    bool ok = tcp ? listenTcp(options.address, listener)
+                  : listenUnix(options.address.substr(unixPrefix.size()), listener);
+    if (!ok) return 1;
+
+    g_stopFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_stopFd < 0) {
+        std::perror("chatbot: eventfd");
+        return 1;
+    }
+
+    struct sigaction sa{};
+    sa.sa_handler = onStopSignal;
+    ::sigemptyset(&sa.sa_mask);
+    ::sigaction(SIGINT, &sa, nullptr);
+    ::sigaction(SIGTERM, &sa, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    SnapshotStore snapshots;
+    std::string error;
+    if (!options.snapshots.empty() && !snapshots.open(options.snapshots, error)) {
+        std::fprintf(stderr, "chatbot: %s\n", error.c_str());
+        return 1;
+    }
+
+    unsigned count = options.workers;
+    if (count == 0) {
+        unsigned cores = std::thread::hardware_concurrency();
+        count = cores == 0 ? 1 : std::min(cores, MAX_DEFAULT_WORKERS);
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (unsigned i = 0; i < count; ++i) {
+        workers.push_back(std::make_unique<Worker>(store, snapshots.isOpen() ? &snapshots : nullptr,
+                                                   listener.fd, tcp, options));
+        std::string log = options.historyLog.empty() ? "" : options.historyLog + "." + std::to_string(i);
+        if (!workers.back()->init(log, error)) {
+            if (error.empty())
+                std::perror("chatbot: epoll");
+            else
+                std::fprintf(stderr, "chatbot: %s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    std::fprintf(stderr, "chatbot: serving %s with %u worker%s (Ctrl+C to stop, SIGHUP to reload)\n",
+                 options.address.c_str(), count, count == 1 ? "" : "s");
+
+    std::vector<std::thread> threads;
+    for (auto& worker : workers) threads.emplace_back(&Worker::run, worker.get());
+    for (auto& t : threads) t.join();
+
+    workers.clear();   // parks the named sessions still connected
+    if (snapshots.isOpen() && !snapshots.compact(error))
+        std::fprintf(stderr, "chatbot: %s\n", error.c_str());
+    ::close(listener.fd);
+    if (!listener.unixPath.empty()) ::unlink(listener.unixPath.c_str());
+    ::close(g_stopFd);
+    std::fprintf(stderr, "chatbot: server stopped\n");
+    return 0;
+}
+
+#else  // !__linux__
+
+int runServer(KnowledgeStore&, const ServerOptions&) {
+    std::fprintf(stderr, "chatbot: server mode needs Linux (epoll)\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ *  server.hpp — Multi-session network server
+ *
+ *  Line-oriented protocol: each '\n'-terminated message from a client
+ *  is answered with exactly one plain-text line (the same text --pipe
+ *  prints). "bye" is answered and then the connection is closed. With
+ *  `welcome`, a session opens with the welcome question on a line of
+ *  its own, and its first answers go to the welcome dialogue.
+ *
+ *  With `snapshots`, a client may name its session: a first line
+ *  "@session NAME" resumes the session parked under NAME — by a dropped
+ *  connection, or by a server that has since restarted — or starts a
+ *  new one under it. The reply is one line, as for any message. Named
+ *  sessions are written to the snapshot file as they go (see
+ *  snapshot.hpp); anonymous ones end with their connection.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "fuzzy.hpp"
+
+class KnowledgeStore;
+
+struct ServerOptions {
+    std::string address;        // "PORT", "HOST:PORT" or "unix:/path"
+    unsigned    workers = 0;    // 0 = one per core, at most 4
+    std::string historyLog;     // "" = none; worker N appends to "<historyLog>.N"
+    unsigned    fuzzyDistance = Fuzzy::DEFAULT_DISTANCE;   // per-session typo allowance
+    std::optional<uint64_t> seed;   // session N (in accept order, from 0) gets seed + N
+    bool        welcome = false;    // start sessions with the welcome questions
+    std::string snapshots;      // "" = none; named sessions are kept in this file
+};
+
+// Serves sessions until SIGINT/SIGTERM; returns the process exit code.
+// Every worker reads the live knowledge base from `store`.
+int runServer(KnowledgeStore& store, const ServerOptions& options);
@@ -0,0 +1,472 @@
+/**
+ *  snapshot.cpp — Session snapshot journal, compaction and lazy restore
+ */
+
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "engine.hpp"
+
+namespace {
+
+    constexpr char     SNAPSHOT_MAGIC[8] = {'C', 'H', 'A', 'T', 'S', 'N', 'A', 'P'};
+    constexpr uint32_t SNAPSHOT_VERSION  = 1;
+    constexpr size_t   FLUSH_BYTES       = 64 * 1024;   // flush early when this much is buffered
+
+    struct FileHeader {
+        char     magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t indexOffset;   // 0 = never compacted
+        uint64_t indexCount;
+    };
+    static_assert(sizeof(FileHeader) == 32);
+
+    enum Kind : uint8_t { Step, Full, Closed };
+
+    struct Fixed {
+        uint64_t prev;
+        uint32_t length;
+        uint8_t  kind;
+        uint8_t  stage;
+        uint8_t  reserved;
+        uint8_t  nameLength;
+        uint64_t messageCount;
+        uint64_t historyTotal;
+        int64_t  startedMs;
+        uint64_t random[4];
+        uint32_t variableCount;
+        uint32_t historyCount;   // messages in this record
+    };
+    static_assert(sizeof(Fixed) == 80);
+
+    struct IndexEntry {
+        uint64_t hash;
+        uint64_t offset;
+    };
+
+    size_t padded(size_t n) { return (n + 7) & ~size_t{7}; }
+
+    uint64_t hashName(std::string_view name) {
+        uint64_t h = 14695981039346656037u;   // FNV-1a
+        for (unsigned char c : name) {
+            h ^= c;
+            h *= 1099511628211u;
+        }
+        return h;
+    }
+
+    template <typename T>
+    void put(std::string& out, const T& value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof value);
+    }
+
+    // {u8 length, name, f64 value} per variable
+    uint32_t encodeVariables(std::string& out, const Expr::Variables& variables) {
+        uint32_t count = 0;
+        for (const auto& [name, value] : variables) {
+            if (name.size() > UINT8_MAX) continue;   // never: see Expr::MAX_NAME_BYTES
+            out += static_cast<char>(name.size());
+            out += name;
+            put(out, value);
+            ++count;
+        }
+        return count;
+    }
+
+    // One record at the end of `out`, padded to 8 bytes
+    void encodeRecord(std::string& out, Fixed fixed, std::string_view name, std::string_view variables,
+                      const std::string_view* messages, size_t count) {
+        const size_t begin = out.size();
+        out.append(sizeof fixed, '\0');
+        out.append(name);
+        out.append(variables);
+        for (size_t i = 0; i < count; ++i) {
+            put(out, static_cast<uint32_t>(messages[i].size()));
+            out.append(messages[i]);
+        }
+        fixed.length       = static_cast<uint32_t>(out.size() - begin - sizeof fixed);
+        fixed.nameLength   = static_cast<uint8_t>(name.size());
+        fixed.historyCount = static_cast<uint32_t>(count);
+        std::memcpy(&out[begin], &fixed, sizeof fixed);
+        out.append(padded(out.size() - begin) - (out.size() - begin), '\0');
+    }
+
+    int64_t nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+// A record read through the mapping; the views stay valid until the
+// next remap
+struct SnapshotStore::Record {
+    Fixed            fixed;
+    std::string_view name;
+    std::string_view variables;   // encoded, fixed.variableCount of them
+    std::string_view messages;    // encoded, fixed.historyCount of them
+
+    template <typename Fn>
+    bool forEachMessage(Fn&& fn) const {
+        size_t at = 0;
+        for (uint32_t i = 0; i < fixed.historyCount; ++i) {
+            uint32_t length;
+            if (messages.size() - at < sizeof length) return false;
+            std::memcpy(&length, messages.data() + at, sizeof length);
+            at += sizeof length;
+            if (messages.size() - at < length) return false;
+            fn(messages.substr(at, length));
+            at += length;
+        }
+        return true;
+    }
+
+    // The newest History::MAX_ENTRIES messages of the chain ending here,
+    // oldest first
+    size_t collect(SnapshotStore& store, std::string_view* out) const {
+        constexpr size_t MAX = History::MAX_ENTRIES;
+        std::string_view newestFirst[MAX];
+        size_t n = 0;
+        std::vector<std::string_view> full;
+        for (Record r = *this;;) {
+            if (r.fixed.kind == Full) {
+                r.forEachMessage([&](std::string_view m) { full.push_back(m); });
+                for (size_t i = full.size(); i > 0 && n < MAX; --i) newestFirst[n++] = full[i - 1];
+                break;
+            }
+            r.forEachMessage([&](std::string_view m) {
+                if (n < MAX) newestFirst[n++] = m;
+            });
+            if (n == MAX || r.fixed.prev == 0 || !store.readRecord(r.fixed.prev, r)) break;
+        }
+        std::reverse_copy(newestFirst, newestFirst + n, out);
+        return n;
+    }
+};
+
+// ─── File ───────────────────────────────────────────────────────
+
+SnapshotStore::~SnapshotStore() {
+    if (!file_) return;
+    flush();
+    std::fclose(file_);
+}
+
+bool SnapshotStore::open(const std::string& path, std::string& error) {
+    std::FILE* f = std::fopen(path.c_str(), "ab+");
+    if (!f) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    std::setvbuf(f, nullptr, _IONBF, 0);   // buffering happens in buffer_
+
+    std::fseek(f, 0, SEEK_END);
+    long size = std::ftell(f);
+    if (size == 0) {
+        FileHeader header{};
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC);
+        header.version = SNAPSHOT_VERSION;
+        if (std::fwrite(&header, 1, sizeof header, f) != sizeof header) {
+            error = path + ": " + std::strerror(errno);
+            std::fclose(f);
+            return false;
+        }
+        size = sizeof header;
+    }
+
+    file_ = f;
+    path_ = path;
+    size_ = static_cast<uint64_t>(size);
+    if (!map_.open(path, error)) {
+        std::fclose(file_);
+        file_ = nullptr;
+        return false;
+    }
+
+    FileHeader header{};
+    bool ok = map_.size() >= sizeof header;
+    if (ok) std::memcpy(&header, map_.data(), sizeof header);
+    ok = ok && std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC) == 0 &&
+         header.version == SNAPSHOT_VERSION && header.indexCount <= (map_.size() - sizeof header) / sizeof(IndexEntry) &&
+         (header.indexOffset == 0 ? header.indexCount == 0
+                                  : header.indexOffset >= sizeof header && header.indexOffset % 8 == 0 &&
+                                        header.indexOffset <= map_.size() - header.indexCount * sizeof(IndexEntry));
+    if (!ok) {
+        error = path + ": not a session snapshot file";
+        std::fclose(file_);
+        file_ = nullptr;
+        map_.close();
+        return false;
+    }
+    indexOffset_ = header.indexOffset;
+    indexCount_  = header.indexCount;
+
+    // Records after the index come from a run that was not compacted;
+    // a torn one at the end (a crash mid-write) is cut off
+    uint64_t offset = indexOffset_ ? indexOffset_ + indexCount_ * sizeof(IndexEntry) : sizeof header;
+    Record r;
+    while (offset < size_ && readRecord(offset, r)) {
+        recent_[std::string(r.name)] = offset;
+        offset += padded(sizeof(Fixed) + r.fixed.length);
+    }
+    if (offset != size_) {
+        std::error_code ec;
+        std::filesystem::resize_file(path, offset, ec);
+        if (ec) {
+            error = path + ": " + ec.message();
+            std::fclose(file_);
+            file_ = nullptr;
+            return false;
+        }
+        size_ = offset;
+        map_.open(path, error);
+    }
+    return true;
+}
+
+bool SnapshotStore::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return writeBuffer();
+}
+
+bool SnapshotStore::writeBuffer() {
+    if (!file_ || buffer_.empty()) return !failed_;
+    if (std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+        if (!failed_) std::fprintf(stderr, "chatbot: snapshots %s: %s\n", path_.c_str(), std::strerror(errno));
+        failed_ = true;
+    }
+    buffer_.clear();
+    return !failed_;
+}
+
+// Remaps only when `end` lies beyond the current mapping
+bool SnapshotStore::mapped(uint64_t end) {
+    if (end <= map_.size()) return true;
+    std::string error;
+    if (!writeBuffer() || !map_.open(path_, error)) return false;
+    return end <= map_.size();
+}
+
+bool SnapshotStore::readRecord(uint64_t offset, Record& out) {
+    if (offset < sizeof(FileHeader) || offset % 8 != 0 || !mapped(offset + sizeof(Fixed))) return false;
+
+    Fixed fixed;
+    std::memcpy(&fixed, map_.data() + offset, sizeof fixed);
+    if (fixed.length > map_.size() - offset - sizeof fixed || fixed.prev >= offset || fixed.kind > Closed ||
+        fixed.stage > static_cast<uint8_t>(Stage::Calculator) || fixed.nameLength > fixed.length)
+        return false;
+
+    const char* body = reinterpret_cast<const char*>(map_.data() + offset + sizeof fixed);
+    std::string_view rest(body, fixed.length);
+    out.fixed = fixed;
+    out.name  = rest.substr(0, fixed.nameLength);
+    rest.remove_prefix(fixed.nameLength);
+
+    size_t at = 0;
+    for (uint32_t i = 0; i < fixed.variableCount; ++i) {
+        if (at >= rest.size()) return false;
+        at += 1 + static_cast<unsigned char>(rest[at]) + sizeof(double);
+        if (at > rest.size()) return false;
+    }
+    out.variables = rest.substr(0, at);
+    out.messages  = rest.substr(at);
+    return true;
+}
+
+// The session's newest record, 0 if it has none
+uint64_t SnapshotStore::newest(std::string_view name) {
+    if (auto it = recent_.find(std::string(name)); it != recent_.end()) return it->second;
+    if (indexCount_ == 0 || !mapped(indexOffset_ + indexCount_ * sizeof(IndexEntry))) return 0;
+
+    const uint64_t hash = hashName(name);
+    auto entry = [&](uint64_t i) {
+        IndexEntry e;
+        std::memcpy(&e, map_.data() + indexOffset_ + i * sizeof e, sizeof e);
+        return e;
+    };
+    uint64_t lo = 0, hi = indexCount_;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (entry(mid).hash < hash) lo = mid + 1; else hi = mid;
+    }
+    for (Record r; lo < indexCount_ && entry(lo).hash == hash; ++lo) {
+        IndexEntry e = entry(lo);
+        if (readRecord(e.offset, r) && r.name == name) return e.offset;
+    }
+    return 0;
+}
+
+// ─── Sessions ───────────────────────────────────────────────────
+
+bool SnapshotStore::validName(std::string_view name) {
+    if (name.empty() || name.size() > MAX_NAME_BYTES) return false;
+    for (char c : name) {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                  c == '.' || c == '_' || c == ':' || c == '-';
+        if (!ok) return false;
+    }
+    return true;
+}
+
+SnapshotStore::Attach SnapshotStore::attach(std::string_view name, Session& session, uint64_t& cursor) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cursor = 0;
+    if (!attached_.emplace(name).second) return Attach::InUse;
+
+    Record r;
+    uint64_t offset = newest(name);
+    if (offset == 0 || !readRecord(offset, r) || r.fixed.kind == Closed) return Attach::Started;
+
+    session.stage        = static_cast<Stage>(r.fixed.stage);
+    session.messageCount = static_cast<size_t>(r.fixed.messageCount);
+    session.random.restore(r.fixed.random);
+
+    auto age = std::chrono::milliseconds(std::max<int64_t>(0, nowMs() - r.fixed.startedMs));
+    session.start = std::chrono::steady_clock::now() -
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(age);
+
+    session.variables.clear();
+    for (size_t at = 0; at < r.variables.size();) {
+        size_t length = static_cast<unsigned char>(r.variables[at]);
+        double value;
+        std::memcpy(&value, r.variables.data() + at + 1 + length, sizeof value);
+        session.variables[std::string(r.variables.substr(at + 1, length))] = value;
+        at += 1 + length + sizeof value;
+    }
+
+    std::string_view messages[History::MAX_ENTRIES];
+    size_t n = r.collect(*this, messages);
+    session.history.restore(messages, n, static_cast<size_t>(r.fixed.historyTotal));
+
+    cursor = offset;
+    return Attach::Resumed;
+}
+
+void SnapshotStore::record(std::string_view name, const Session& session, std::string_view message,
+                           uint64_t& cursor) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_) return;
+
+    Fixed fixed{};
+    fixed.prev         = cursor;
+    fixed.kind         = Step;
+    fixed.stage        = static_cast<uint8_t>(session.stage);
+    fixed.messageCount = session.messageCount;
+    fixed.historyTotal = session.history.total();
+    fixed.startedMs    = nowMs() - std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now() - session.start).count();
+    session.random.save(fixed.random);
+
+    variables_.clear();
+    fixed.variableCount = encodeVariables(variables_, session.variables);
+
+    cursor = size_;
+    const size_t before = buffer_.size();
+    encodeRecord(buffer_, fixed, name, variables_, &message, message.empty() ? 0 : 1);
+    size_ += buffer_.size() - before;
+
+    if (buffer_.size() >= FLUSH_BYTES) writeBuffer();
+}
+
+void SnapshotStore::detach(std::string_view name, uint64_t cursor, bool ended) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    attached_.erase(std::string(name));
+    if (!file_ || cursor == 0) return;
+
+    if (ended) {
+        Fixed fixed{};
+        fixed.prev = cursor;
+        fixed.kind = Closed;
+        cursor = size_;
+        const size_t before = buffer_.size();
+        encodeRecord(buffer_, fixed, name, {}, nullptr, 0);
+        size_ += buffer_.size() - before;
+    }
+    recent_[std::string(name)] = cursor;
+    writeBuffer();   // another worker may attach it next
+}
+
+// ─── Compaction ─────────────────────────────────────────────────
+
+bool SnapshotStore::compact(std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_) return true;
+    if (!attached_.empty()) {
+        error = path_ + ": sessions are still attached";
+        return false;
+    }
+    if (!writeBuffer() || !mapped(size_)) {
+        error = path_ + ": cannot read the snapshots back";
+        return false;
+    }
+
+    // The newest record of every session: indexed ones not touched
+    // since, then the recent ones
+    std::vector<uint64_t> newestRecords;
+    newestRecords.reserve(indexCount_ + recent_.size());
+    Record r;
+    for (uint64_t i = 0; i < indexCount_; ++i) {
+        IndexEntry e;
+        std::memcpy(&e, map_.data() + indexOffset_ + i * sizeof e, sizeof e);
+        if (readRecord(e.offset, r) && recent_.find(std::string(r.name)) == recent_.end())
+            newestRecords.push_back(e.offset);
+    }
+    for (const auto& [name, offset] : recent_) newestRecords.push_back(offset);
+
+    const std::string tmp = path_ + ".tmp";
+    std::FILE* out = std::fopen(tmp.c_str(), "wb");
+    if (!out) {
+        error = tmp + ": " + std::strerror(errno);
+        return false;
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC);
+    header.version = SNAPSHOT_VERSION;
+    bool ok = std::fwrite(&header, 1, sizeof header, out) == sizeof header;
+
+    std::vector<IndexEntry> index;
+    std::string record;
+    std::string_view messages[History::MAX_ENTRIES];
+    uint64_t offset = sizeof header;
+    for (uint64_t at : newestRecords) {
+        if (!ok) break;
+        if (!readRecord(at, r) || r.fixed.kind == Closed) continue;
+        size_t n = r.collect(*this, messages);
+        Fixed fixed = r.fixed;
+        fixed.prev = 0;
+        fixed.kind = Full;
+        record.clear();
+        encodeRecord(record, fixed, r.name, r.variables, messages, n);
+        ok = std::fwrite(record.data(), 1, record.size(), out) == record.size();
+        index.push_back({hashName(r.name), offset});
+        offset += record.size();
+    }
+
+    std::sort(index.begin(), index.end(), [](const IndexEntry& a, const IndexEntry& b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.offset < b.offset;
+    });
+    header.indexOffset = offset;
+    header.indexCount  = index.size();
+    ok = ok && (index.empty() || std::fwrite(index.data(), sizeof(IndexEntry), index.size(), out) == index.size()) &&
+         std::fseek(out, 0, SEEK_SET) == 0 && std::fwrite(&header, 1, sizeof header, out) == sizeof header;
+    if (std::fclose(out) != 0) ok = false;
+    if (!ok || std::rename(tmp.c_str(), path_.c_str()) != 0) {
+        error = path_ + ": cannot write the compacted snapshots";
+        std::remove(tmp.c_str());
+        return false;
+    }
+
+    std::fclose(file_);
+    file_ = nullptr;
+    map_.close();
+    recent_.clear();
+    indexOffset_ = indexCount_ = size_ = 0;
+    return true;
+}
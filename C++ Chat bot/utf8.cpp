@@ -0,0 +1,387 @@
+/**
+ *  utf8.cpp — UTF-8 decoding, case folding, grapheme clusters
+ */
+
+#include "utf8.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Utf8 {
+
+    namespace {
+
+        struct FoldRun {
+            uint32_t first;
+            uint8_t  count;
+            uint8_t  stride;
+            int32_t  delta;
+        };
+
+        struct Range {
+            uint32_t first, last;
+        };
+
+        // Simple case folding above ASCII (Unicode 14.0), as runs: `count`
+        // code points from `first`, `stride` apart, each folding to
+        // itself + `delta`. Ⱥ and Ⱦ are left out: in UTF-8 their folds
+        // are a byte longer, and folding works in place.
+        constexpr FoldRun FOLDS[] = {
+            {0x000B5,  1, 1,    775}, {0x000C0, 23, 1,     32}, {0x000D8,  7, 1,     32},
+            {0x00100, 24, 2,      1}, {0x00132,  3, 2,      1}, {0x00139,  8, 2,      1},
+            {0x0014A, 23, 2,      1}, {0x00178,  1, 1,   -121}, {0x00179,  3, 2,      1},
+            {0x0017F,  1, 1,   -268}, {0x00181,  1, 1,    210}, {0x00182,  2, 2,      1},
+            {0x00186,  1, 1,    206}, {0x00187,  1, 1,      1}, {0x00189,  2, 1,    205},
+            {0x0018B,  1, 1,      1}, {0x0018E,  1, 1,     79}, {0x0018F,  1, 1,    202},
+            {0x00190,  1, 1,    203}, {0x00191,  1, 1,      1}, {0x00193,  1, 1,    205},
+            {0x00194,  1, 1,    207}, {0x00196,  1, 1,    211}, {0x00197,  1, 1,    209},
+            {0x00198,  1, 1,      1}, {0x0019C,  1, 1,    211}, {0x0019D,  1, 1,    213},
+            {0x0019F,  1, 1,    214}, {0x001A0,  3, 2,      1}, {0x001A6,  1, 1,    218},
+            {0x001A7,  1, 1,      1}, {0x001A9,  1, 1,    218}, {0x001AC,  1, 1,      1},
+            {0x001AE,  1, 1,    218}, {0x001AF,  1, 1,      1}, {0x001B1,  2, 1,    217},
+            {0x001B3,  2, 2,      1}, {0x001B7,  1, 1,    219}, {0x001B8,  1, 1,      1},
+            {0x001BC,  1, 1,      1}, {0x001C4,  1, 1,      2}, {0x001C5,  1, 1,      1},
+            {0x001C7,  1, 1,      2}, {0x001C8,  1, 1,      1}, {0x001CA,  1, 1,      2},
+            {0x001CB,  9, 2,      1}, {0x001DE,  9, 2,      1}, {0x001F1,  1, 1,      2},
+            {0x001F2,  2, 2,      1}, {0x001F6,  1, 1,    -97}, {0x001F7,  1, 1,    -56},
+            {0x001F8, 20, 2,      1}, {0x00220,  1, 1,   -130}, {0x00222,  9, 2,      1},
+            {0x0023B,  1, 1,      1}, {0x0023D,  1, 1,   -163}, {0x00241,  1, 1,      1},
+            {0x00243,  1, 1,   -195}, {0x00244,  1, 1,     69}, {0x00245,  1, 1,     71},
+            {0x00246,  5, 2,      1}, {0x00345,  1, 1,    116}, {0x00370,  2, 2,      1},
+            {0x00376,  1, 1,      1}, {0x0037F,  1, 1,    116}, {0x00386,  1, 1,     38},
+            {0x00388,  3, 1,     37}, {0x0038C,  1, 1,     64}, {0x0038E,  2, 1,     63},
+            {0x00391, 17, 1,     32}, {0x003A3,  9, 1,     32}, {0x003C2,  1, 1,      1},
+            {0x003CF,  1, 1,      8}, {0x003D0,  1, 1,    -30}, {0x003D1,  1, 1,    -25},
+            {0x003D5,  1, 1,    -15}, {0x003D6,  1, 1,    -22}, {0x003D8, 12, 2,      1},
+            {0x003F0,  1, 1,    -54}, {0x003F1,  1, 1,    -48}, {0x003F4,  1, 1,    -60},
+            {0x003F5,  1, 1,    -64}, {0x003F7,  1, 1,      1}, {0x003F9,  1, 1,     -7},
+            {0x003FA,  1, 1,      1}, {0x003FD,  3, 1,   -130}, {0x00400, 16, 1,     80},
+            {0x00410, 32, 1,     32}, {0x00460, 17, 2,      1}, {0x0048A, 27, 2,      1},
+            {0x004C0,  1, 1,     15}, {0x004C1,  7, 2,      1}, {0x004D0, 48, 2,      1},
+            {0x00531, 38, 1,     48}, {0x010A0, 38, 1,   7264}, {0x010C7,  1, 1,   7264},
+            {0x010CD,  1, 1,   7264}, {0x013F8,  6, 1,     -8}, {0x01C80,  1, 1,  -6222},
+            {0x01C81,  1, 1,  -6221}, {0x01C82,  1, 1,  -6212}, {0x01C83,  2, 1,  -6210},
+            {0x01C85,  1, 1,  -6211}, {0x01C86,  1, 1,  -6204}, {0x01C87,  1, 1,  -6180},
+            {0x01C88,  1, 1,  35267}, {0x01C90, 43, 1,  -3008}, {0x01CBD,  3, 1,  -3008},
+            {0x01E00, 75, 2,      1}, {0x01E9B,  1, 1,    -58}, {0x01E9E,  1, 1,  -7615},
+            {0x01EA0, 48, 2,      1}, {0x01F08,  8, 1,     -8}, {0x01F18,  6, 1,     -8},
+            {0x01F28,  8, 1,     -8}, {0x01F38,  8, 1,     -8}, {0x01F48,  6, 1,     -8},
+            {0x01F59,  4, 2,     -8}, {0x01F68,  8, 1,     -8}, {0x01F88,  8, 1,     -8},
+            {0x01F98,  8, 1,     -8}, {0x01FA8,  8, 1,     -8}, {0x01FB8,  2, 1,     -8},
+            {0x01FBA,  2, 1,    -74}, {0x01FBC,  1, 1,     -9}, {0x01FBE,  1, 1,  -7173},
+            {0x01FC8,  4, 1,    -86}, {0x01FCC,  1, 1,     -9}, {0x01FD8,  2, 1,     -8},
+            {0x01FDA,  2, 1,   -100}, {0x01FE8,  2, 1,     -8}, {0x01FEA,  2, 1,   -112},
+            {0x01FEC,  1, 1,     -7}, {0x01FF8,  2, 1,   -128}, {0x01FFA,  2, 1,   -126},
+            {0x01FFC,  1, 1,     -9}, {0x02126,  1, 1,  -7517}, {0x0212A,  1, 1,  -8383},
+            {0x0212B,  1, 1,  -8262}, {0x02132,  1, 1,     28}, {0x02160, 16, 1,     16},
+            {0x02183,  1, 1,      1}, {0x024B6, 26, 1,     26}, {0x02C00, 48, 1,     48},
+            {0x02C60,  1, 1,      1}, {0x02C62,  1, 1, -10743}, {0x02C63,  1, 1,  -3814},
+            {0x02C64,  1, 1, -10727}, {0x02C67,  3, 2,      1}, {0x02C6D,  1, 1, -10780},
+            {0x02C6E,  1, 1, -10749}, {0x02C6F,  1, 1, -10783}, {0x02C70,  1, 1, -10782},
+            {0x02C72,  1, 1,      1}, {0x02C75,  1, 1,      1}, {0x02C7E,  2, 1, -10815},
+            {0x02C80, 50, 2,      1}, {0x02CEB,  2, 2,      1}, {0x02CF2,  1, 1,      1},
+            {0x0A640, 23, 2,      1}, {0x0A680, 14, 2,      1}, {0x0A722,  7, 2,      1},
+            {0x0A732, 31, 2,      1}, {0x0A779,  2, 2,      1}, {0x0A77D,  1, 1, -35332},
+            {0x0A77E,  5, 2,      1}, {0x0A78B,  1, 1,      1}, {0x0A78D,  1, 1, -42280},
+            {0x0A790,  2, 2,      1}, {0x0A796, 10, 2,      1}, {0x0A7AA,  1, 1, -42308},
+            {0x0A7AB,  1, 1, -42319}, {0x0A7AC,  1, 1, -42315}, {0x0A7AD,  1, 1, -42305},
+            {0x0A7AE,  1, 1, -42308}, {0x0A7B0,  1, 1, -42258}, {0x0A7B1,  1, 1, -42282},
+            {0x0A7B2,  1, 1, -42261}, {0x0A7B3,  1, 1,    928}, {0x0A7B4,  8, 2,      1},
+            {0x0A7C4,  1, 1,    -48}, {0x0A7C5,  1, 1, -42307}, {0x0A7C6,  1, 1, -35384},
+            {0x0A7C7,  2, 2,      1}, {0x0A7D0,  1, 1,      1}, {0x0A7D6,  2, 2,      1},
+            {0x0A7F5,  1, 1,      1}, {0x0AB70, 80, 1, -38864}, {0x0FF21, 26, 1,     32},
+            {0x10400, 40, 1,     40}, {0x104B0, 36, 1,     40}, {0x10570, 11, 1,     39},
+            {0x1057C, 15, 1,     39}, {0x1058C,  7, 1,     39}, {0x10594,  2, 1,     39},
+            {0x10C80, 51, 1,     64}, {0x118A0, 32, 1,     32}, {0x16E40, 32, 1,     32},
+            {0x1E900, 34, 1,     34},
+        };
+
+        // Combining marks (general categories Mn, Me and Mc), which
+        // extend the grapheme before them (Unicode 14.0)
+        constexpr Range MARKS[] = {
+            {0x00300, 0x0036F}, {0x00483, 0x00489}, {0x00591, 0x005BD}, {0x005BF, 0x005BF},
+            {0x005C1, 0x005C2}, {0x005C4, 0x005C5}, {0x005C7, 0x005C7}, {0x00610, 0x0061A},
+            {0x0064B, 0x0065F}, {0x00670, 0x00670}, {0x006D6, 0x006DC}, {0x006DF, 0x006E4},
+            {0x006E7, 0x006E8}, {0x006EA, 0x006ED}, {0x00711, 0x00711}, {0x00730, 0x0074A},
+            {0x007A6, 0x007B0}, {0x007EB, 0x007F3}, {0x007FD, 0x007FD}, {0x00816, 0x00819},
+            {0x0081B, 0x00823}, {0x00825, 0x00827}, {0x00829, 0x0082D}, {0x00859, 0x0085B},
+            {0x00898, 0x0089F}, {0x008CA, 0x008E1}, {0x008E3, 0x00903}, {0x0093A, 0x0093C},
+            {0x0093E, 0x0094F}, {0x00951, 0x00957}, {0x00962, 0x00963}, {0x00981, 0x00983},
+            {0x009BC, 0x009BC}, {0x009BE, 0x009C4}, {0x009C7, 0x009C8}, {0x009CB, 0x009CD},
+            {0x009D7, 0x009D7}, {0x009E2, 0x009E3}, {0x009FE, 0x009FE}, {0x00A01, 0x00A03},
+            {0x00A3C, 0x00A3C}, {0x00A3E, 0x00A42}, {0x00A47, 0x00A48}, {0x00A4B, 0x00A4D},
+            {0x00A51, 0x00A51}, {0x00A70, 0x00A71}, {0x00A75, 0x00A75}, {0x00A81, 0x00A83},
+            {0x00ABC, 0x00ABC}, {0x00ABE, 0x00AC5}, {0x00AC7, 0x00AC9}, {0x00ACB, 0x00ACD},
+            {0x00AE2, 0x00AE3}, {0x00AFA, 0x00AFF}, {0x00B01, 0x00B03}, {0x00B3C, 0x00B3C},
+            {0x00B3E, 0x00B44}, {0x00B47, 0x00B48}, {0x00B4B, 0x00B4D}, {0x00B55, 0x00B57},
+            {0x00B62, 0x00B63}, {0x00B82, 0x00B82}, {0x00BBE, 0x00BC2}, {0x00BC6, 0x00BC8},
+            {0x00BCA, 0x00BCD}, {0x00BD7, 0x00BD7}, {0x00C00, 0x00C04}, {0x00C3C, 0x00C3C},
+            {0x00C3E, 0x00C44}, {0x00C46, 0x00C48}, {0x00C4A, 0x00C4D}, {0x00C55, 0x00C56},
+            {0x00C62, 0x00C63}, {0x00C81, 0x00C83}, {0x00CBC, 0x00CBC}, {0x00CBE, 0x00CC4},
+            {0x00CC6, 0x00CC8}, {0x00CCA, 0x00CCD}, {0x00CD5, 0x00CD6}, {0x00CE2, 0x00CE3},
+            {0x00D00, 0x00D03}, {0x00D3B, 0x00D3C}, {0x00D3E, 0x00D44}, {0x00D46, 0x00D48},
+            {0x00D4A, 0x00D4D}, {0x00D57, 0x00D57}, {0x00D62, 0x00D63}, {0x00D81, 0x00D83},
+            {0x00DCA, 0x00DCA}, {0x00DCF, 0x00DD4}, {0x00DD6, 0x00DD6}, {0x00DD8, 0x00DDF},
+            {0x00DF2, 0x00DF3}, {0x00E31, 0x00E31}, {0x00E34, 0x00E3A}, {0x00E47, 0x00E4E},
+            {0x00EB1, 0x00EB1}, {0x00EB4, 0x00EBC}, {0x00EC8, 0x00ECD}, {0x00F18, 0x00F19},
+            {0x00F35, 0x00F35}, {0x00F37, 0x00F37}, {0x00F39, 0x00F39}, {0x00F3E, 0x00F3F},
+            {0x00F71, 0x00F84}, {0x00F86, 0x00F87}, {0x00F8D, 0x00F97}, {0x00F99, 0x00FBC},
+            {0x00FC6, 0x00FC6}, {0x0102B, 0x0103E}, {0x01056, 0x01059}, {0x0105E, 0x01060},
+            {0x01062, 0x01064}, {0x01067, 0x0106D}, {0x01071, 0x01074}, {0x01082, 0x0108D},
+            {0x0108F, 0x0108F}, {0x0109A, 0x0109D}, {0x0135D, 0x0135F}, {0x01712, 0x01715},
+            {0x01732, 0x01734}, {0x01752, 0x01753}, {0x01772, 0x01773}, {0x017B4, 0x017D3},
+            {0x017DD, 0x017DD}, {0x0180B, 0x0180D}, {0x0180F, 0x0180F}, {0x01885, 0x01886},
+            {0x018A9, 0x018A9}, {0x01920, 0x0192B}, {0x01930, 0x0193B}, {0x01A17, 0x01A1B},
+            {0x01A55, 0x01A5E}, {0x01A60, 0x01A7C}, {0x01A7F, 0x01A7F}, {0x01AB0, 0x01ACE},
+            {0x01B00, 0x01B04}, {0x01B34, 0x01B44}, {0x01B6B, 0x01B73}, {0x01B80, 0x01B82},
+            {0x01BA1, 0x01BAD}, {0x01BE6, 0x01BF3}, {0x01C24, 0x01C37}, {0x01CD0, 0x01CD2},
+            {0x01CD4, 0x01CE8}, {0x01CED, 0x01CED}, {0x01CF4, 0x01CF4}, {0x01CF7, 0x01CF9},
+            {0x01DC0, 0x01DFF}, {0x020D0, 0x020F0}, {0x02CEF, 0x02CF1}, {0x02D7F, 0x02D7F},
+            {0x02DE0, 0x02DFF}, {0x0302A, 0x0302F}, {0x03099, 0x0309A}, {0x0A66F, 0x0A672},
+            {0x0A674, 0x0A67D}, {0x0A69E, 0x0A69F}, {0x0A6F0, 0x0A6F1}, {0x0A802, 0x0A802},
+            {0x0A806, 0x0A806}, {0x0A80B, 0x0A80B}, {0x0A823, 0x0A827}, {0x0A82C, 0x0A82C},
+            {0x0A880, 0x0A881}, {0x0A8B4, 0x0A8C5}, {0x0A8E0, 0x0A8F1}, {0x0A8FF, 0x0A8FF},
+            {0x0A926, 0x0A92D}, {0x0A947, 0x0A953}, {0x0A980, 0x0A983}, {0x0A9B3, 0x0A9C0},
+            {0x0A9E5, 0x0A9E5}, {0x0AA29, 0x0AA36}, {0x0AA43, 0x0AA43}, {0x0AA4C, 0x0AA4D},
+            {0x0AA7B, 0x0AA7D}, {0x0AAB0, 0x0AAB0}, {0x0AAB2, 0x0AAB4}, {0x0AAB7, 0x0AAB8},
+            {0x0AABE, 0x0AABF}, {0x0AAC1, 0x0AAC1}, {0x0AAEB, 0x0AAEF}, {0x0AAF5, 0x0AAF6},
+            {0x0ABE3, 0x0ABEA}, {0x0ABEC, 0x0ABED}, {0x0FB1E, 0x0FB1E}, {0x0FE00, 0x0FE0F},
+            {0x0FE20, 0x0FE2F}, {0x101FD, 0x101FD}, {0x102E0, 0x102E0}, {0x10376, 0x1037A},
+            {0x10A01, 0x10A03}, {0x10A05, 0x10A06}, {0x10A0C, 0x10A0F}, {0x10A38, 0x10A3A},
+            {0x10A3F, 0x10A3F}, {0x10AE5, 0x10AE6}, {0x10D24, 0x10D27}, {0x10EAB, 0x10EAC},
+            {0x10F46, 0x10F50}, {0x10F82, 0x10F85}, {0x11000, 0x11002}, {0x11038, 0x11046},
+            {0x11070, 0x11070}, {0x11073, 0x11074}, {0x1107F, 0x11082}, {0x110B0, 0x110BA},
+            {0x110C2, 0x110C2}, {0x11100, 0x11102}, {0x11127, 0x11134}, {0x11145, 0x11146},
+            {0x11173, 0x11173}, {0x11180, 0x11182}, {0x111B3, 0x111C0}, {0x111C9, 0x111CC},
+            {0x111CE, 0x111CF}, {0x1122C, 0x11237}, {0x1123E, 0x1123E}, {0x112DF, 0x112EA},
+            {0x11300, 0x11303}, {0x1133B, 0x1133C}, {0x1133E, 0x11344}, {0x11347, 0x11348},
+            {0x1134B, 0x1134D}, {0x11357, 0x11357}, {0x11362, 0x11363}, {0x11366, 0x1136C},
+            {0x11370, 0x11374}, {0x11435, 0x11446}, {0x1145E, 0x1145E}, {0x114B0, 0x114C3},
+            {0x115AF, 0x115B5}, {0x115B8, 0x115C0}, {0x115DC, 0x115DD}, {0x11630, 0x11640},
+            {0x116AB, 0x116B7}, {0x1171D, 0x1172B}, {0x1182C, 0x1183A}, {0x11930, 0x11935},
+            {0x11937, 0x11938}, {0x1193B, 0x1193E}, {0x11940, 0x11940}, {0x11942, 0x11943},
+            {0x119D1, 0x119D7}, {0x119DA, 0x119E0}, {0x119E4, 0x119E4}, {0x11A01, 0x11A0A},
+            {0x11A33, 0x11A39}, {0x11A3B, 0x11A3E}, {0x11A47, 0x11A47}, {0x11A51, 0x11A5B},
+            {0x11A8A, 0x11A99}, {0x11C2F, 0x11C36}, {0x11C38, 0x11C3F}, {0x11C92, 0x11CA7},
+            {0x11CA9, 0x11CB6}, {0x11D31, 0x11D36}, {0x11D3A, 0x11D3A}, {0x11D3C, 0x11D3D},
+            {0x11D3F, 0x11D45}, {0x11D47, 0x11D47}, {0x11D8A, 0x11D8E}, {0x11D90, 0x11D91},
+            {0x11D93, 0x11D97}, {0x11EF3, 0x11EF6}, {0x16AF0, 0x16AF4}, {0x16B30, 0x16B36},
+            {0x16F4F, 0x16F4F}, {0x16F51, 0x16F87}, {0x16F8F, 0x16F92}, {0x16FE4, 0x16FE4},
+            {0x16FF0, 0x16FF1}, {0x1BC9D, 0x1BC9E}, {0x1CF00, 0x1CF2D}, {0x1CF30, 0x1CF46},
+            {0x1D165, 0x1D169}, {0x1D16D, 0x1D172}, {0x1D17B, 0x1D182}, {0x1D185, 0x1D18B},
+            {0x1D1AA, 0x1D1AD}, {0x1D242, 0x1D244}, {0x1DA00, 0x1DA36}, {0x1DA3B, 0x1DA6C},
+            {0x1DA75, 0x1DA75}, {0x1DA84, 0x1DA84}, {0x1DA9B, 0x1DA9F}, {0x1DAA1, 0x1DAAF},
+            {0x1E000, 0x1E006}, {0x1E008, 0x1E018}, {0x1E01B, 0x1E021}, {0x1E023, 0x1E024},
+            {0x1E026, 0x1E02A}, {0x1E130, 0x1E136}, {0x1E2AE, 0x1E2AE}, {0x1E2EC, 0x1E2EF},
+            {0x1E8D0, 0x1E8D6}, {0x1E944, 0x1E94A}, {0xE0100, 0xE01EF},
+        };
+
+        constexpr uint32_t ZWNJ              = 0x200C;
+        constexpr uint32_t ZWJ               = 0x200D;
+        constexpr uint32_t COMBINING_DOT     = 0x0307;
+        constexpr uint32_t REGIONAL_FIRST    = 0x1F1E6;
+        constexpr uint32_t REGIONAL_LAST     = 0x1F1FF;
+
+        bool isRegional(uint32_t cp) { return cp >= REGIONAL_FIRST && cp <= REGIONAL_LAST; }
+
+        // Continues the cluster before it
+        bool extends(uint32_t cp) {
+            if (cp == ZWNJ || cp == ZWJ) return true;
+            if (cp >= 0x1F3FB && cp <= 0x1F3FF) return true;   // emoji skin tones
+            if (cp >= 0xE0020 && cp <= 0xE007F) return true;   // tags (subdivision flags)
+            if (cp >= 0x1160 && cp <= 0x11FF) return true;     // Hangul medial and final jamo
+            const Range* r = std::upper_bound(std::begin(MARKS), std::end(MARKS), cp,
+                                              [](uint32_t c, const Range& m) { return c < m.first; });
+            return r != std::begin(MARKS) && cp <= r[-1].last;
+        }
+
+        size_t encode(uint32_t cp, char* out) {
+            if (cp < 0x80) {
+                out[0] = static_cast<char>(cp);
+                return 1;
+            }
+            if (cp < 0x800) {
+                out[0] = static_cast<char>(0xC0 | cp >> 6);
+                out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+                return 2;
+            }
+            if (cp < 0x10000) {
+                out[0] = static_cast<char>(0xE0 | cp >> 12);
+                out[1] = static_cast<char>(0x80 | (cp >> 6 & 0x3F));
+                out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+                return 3;
+            }
+            out[0] = static_cast<char>(0xF0 | cp >> 18);
+            out[1] = static_cast<char>(0x80 | (cp >> 12 & 0x3F));
+            out[2] = static_cast<char>(0x80 | (cp >> 6 & 0x3F));
+            out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+            return 4;
+        }
+
+        // Bytes in the grapheme cluster starting at text[i]
+        size_t clusterLength(std::string_view text, size_t i) {
+            const char* p = text.data();
+            const size_t size = text.size();
+            uint32_t cp = static_cast<unsigned char>(p[i]);
+            size_t n = 1;
+            if (cp >= 0x80 && (n = decode(p + i, size - i, cp)) == 0) return 1;
+            if (cp < 0x80 && (i + 1 == size || static_cast<unsigned char>(p[i + 1]) < 0x80)) return 1;
+
+            size_t end = i + n;
+            bool pairOpen = isRegional(cp);
+            uint32_t last = cp;
+            while (end < size) {
+                uint32_t next = static_cast<unsigned char>(p[end]);
+                if (next < 0x80 || (n = decode(p + end, size - end, next)) == 0) break;
+                if (extends(next) || last == ZWJ) {
+                    // part of this cluster
+                } else if (pairOpen && isRegional(next)) {
+                    pairOpen = false;
+                } else {
+                    break;
+                }
+                last = next;
+                end += n;
+            }
+            return end - i;
+        }
+    }
+
+    bool isAscii(const char* data, size_t size) {
+        size_t i = 0;
+#ifdef __SSE2__
+        __m128i high = _mm_setzero_si128();
+        for (; i + 16 <= size; i += 16)
+            high = _mm_or_si128(high, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+        if (_mm_movemask_epi8(high)) return false;
+#endif
+        unsigned char bits = 0;
+        for (; i < size; ++i) bits |= static_cast<unsigned char>(data[i]);
+        return bits < 0x80;
+    }
+
+    size_t decode(const char* p, size_t left, uint32_t& cp) {
+        const auto* s = reinterpret_cast<const unsigned char*>(p);
+        const unsigned char b0 = s[0];
+        if (b0 < 0x80) {
+            cp = b0;
+            return 1;
+        }
+
+        // Lead byte: length and the valid range of the second byte
+        // (which rules out overlong forms, surrogates and > U+10FFFF)
+        size_t n;
+        unsigned char lo = 0x80, hi = 0xBF;
+        if (b0 >= 0xC2 && b0 <= 0xDF)      { n = 2; cp = b0 & 0x1F; }
+        else if (b0 >= 0xE0 && b0 <= 0xEF) { n = 3; cp = b0 & 0x0F; lo = b0 == 0xE0 ? 0xA0 : 0x80; hi = b0 == 0xED ? 0x9F : 0xBF; }
+        else if (b0 >= 0xF0 && b0 <= 0xF4) { n = 4; cp = b0 & 0x07; lo = b0 == 0xF0 ? 0x90 : 0x80; hi = b0 == 0xF4 ? 0x8F : 0xBF; }
+        else return 0;
+
+        if (left < n || s[1] < lo || s[1] > hi) return 0;
+        for (size_t k = 1; k < n; ++k) {
+            if ((s[k] & 0xC0) != 0x80) return 0;
+            cp = cp << 6 | (s[k] & 0x3F);
+        }
+        return n;
+    }
+
+    bool valid(std::string_view text) {
+        const char* p = text.data();
+        size_t left = text.size();
+        while (left > 0) {
+#ifdef __SSE2__
+            while (left >= 16 && !_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))) {
+                p += 16;
+                left -= 16;
+            }
+            if (left == 0) break;
+#endif
+            uint32_t cp;
+            size_t n = decode(p, left, cp);
+            if (n == 0) return false;
+            p += n;
+            left -= n;
+        }
+        return true;
+    }
+
+    uint32_t fold(uint32_t cp) {
+        if (cp < 0x80) return cp >= 'A' && cp <= 'Z' ? cp | 0x20 : cp;
+        if (cp == 0x130 || cp == 0x131) return 'i';   // İ and ı
+        const FoldRun* r = std::upper_bound(std::begin(FOLDS), std::end(FOLDS), cp,
+                                            [](uint32_t c, const FoldRun& run) { return c < run.first; });
+        if (r == std::begin(FOLDS)) return cp;
+        --r;
+        uint32_t offset = cp - r->first;
+        if (offset % r->stride != 0 || offset / r->stride >= r->count) return cp;
+        return static_cast<uint32_t>(static_cast<int32_t>(cp) + r->delta);
+    }
+
+    size_t foldInPlace(char* data, size_t size) {
+        size_t r = 0, w = 0;
+        while (r < size) {
+            unsigned char c = static_cast<unsigned char>(data[r]);
+            if (c < 0x80) {
+                data[w++] = static_cast<char>(c >= 'A' && c <= 'Z' ? c | 0x20 : c);
+                ++r;
+                continue;
+            }
+            uint32_t cp;
+            size_t n = decode(data + r, size - r, cp);
+            if (n == 0) {
+                data[w++] = '?';
+                ++r;
+                continue;
+            }
+            r += n;
+            if (cp == COMBINING_DOT && w > 0 && data[w - 1] == 'i') continue;   // i̇, as İ lowercases
+            w += encode(fold(cp), data + w);   // never longer than the n bytes read
+        }
+        return w;
+    }
+
+    bool isSpace(uint32_t cp) {
+        if (cp < 0x80) return cp == ' ' || (cp >= '\t' && cp <= '\r');
+        return cp == 0x85 || cp == 0xA0 || cp == 0x1680 || (cp >= 0x2000 && cp <= 0x200A) ||
+               cp == 0x2028 || cp == 0x2029 || cp == 0x202F || cp == 0x205F || cp == 0x3000;
+    }
+
+    size_t countWords(std::string_view text) {
+        size_t count = 0;
+        bool inWord = false;
+        for (size_t i = 0; i < text.size();) {
+            uint32_t cp = static_cast<unsigned char>(text[i]);
+            size_t n = 1;
+            if (cp >= 0x80 && (n = decode(text.data() + i, text.size() - i, cp)) == 0) n = 1;   // a stray byte is a letter
+            bool space = isSpace(cp);
+            count += !space && !inWord;
+            inWord = !space;
+            i += n;
+        }
+        return count;
+    }
+
+    void appendReversed(std::string& out, std::string_view text) {
+        // Resized, then written: append() from reverse iterators would
+        // build a temporary string
+        const size_t base = out.size();
+        out.resize(base + text.size());
+        if (isAscii(text.data(), text.size())) {
+            std::reverse_copy(text.begin(), text.end(), out.begin() + static_cast<std::ptrdiff_t>(base));
+            return;
+        }
+
+        // Each cluster, left to right, goes to its mirrored place
+        char* dest = out.data() + base + text.size();
+        for (size_t i = 0; i < text.size();) {
+            size_t n = clusterLength(text, i);
+            dest -= n;
+            std::memcpy(dest, text.data() + i, n);
+            i += n;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+/**
+ *  utf8.hpp — UTF-8 validation, case folding, graphemes and words
+ *
+ *  Messages come in any language. Normalization lowercases ASCII first,
+ *  16 bytes per step, and only text with bytes above 0x7F goes on to the
+ *  Unicode case folding here — English traffic never reaches it.
+ *
+ *  Folding is Unicode's simple case folding, which never makes UTF-8
+ *  text longer here, so it works in place. The Turkish dotted and
+ *  dotless i fold together: I, İ, ı and i (also i + U+0307) all become
+ *  i, so a key matches however the keyboard or locale spelled it.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Utf8 {
+
+    // True if no byte is above 0x7F; 16 bytes per step with SSE2
+    bool isAscii(const char* data, size_t size);
+
+    // Well-formed UTF-8: no overlong forms, surrogates or code points
+    // above U+10FFFF. ASCII runs are skipped 16 bytes at a time.
+    bool valid(std::string_view text);
+
+    // Decodes the code point at `p`, `left` > 0 bytes from the end.
+    // Returns its length in bytes, or 0 if it is not well-formed.
+    size_t decode(const char* p, size_t left, uint32_t& cp);
+
+    // Simple case folding of one code point
+    uint32_t fold(uint32_t cp);
+
+    // Folds the UTF-8 text in place and returns its new size, never
+    // larger. A byte that is not part of well-formed UTF-8 becomes '?'.
+    size_t foldInPlace(char* data, size_t size);
+
+    // White_Space code points: ASCII spaces and controls \t-\r, NEL,
+    // no-break spaces, the U+2000 block spaces, line and paragraph
+    // separators, ideographic space
+    bool isSpace(uint32_t cp);
+
+    // Words separated by Unicode whitespace
+    size_t countWords(std::string_view text);
+
+    // Appends `text` with its grapheme clusters in reverse order, so
+    // accents stay on their letters and emoji sequences (flags, skin
+    // tones, ZWJ families) stay whole. Clusters are a base character
+    // plus combining marks, variation selectors, emoji modifiers and
+    // tags, joined across U+200D; regional indicators pair up.
+    void appendReversed(std::string& out, std::string_view text);
+}
@@ -0,0 +1,168 @@
+/**
+ *  util.cpp — Text and time helpers
+ */
+
+#include "util.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <new>
+#include <random>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "utf8.hpp"
+
+namespace Util {
+
+    // ASCII lowercase in place; true if any byte is above 0x7F
+    static bool lowerAscii(char* data, size_t size) {
+        size_t i = 0;
+        int high = 0;
+#ifdef __SSE2__
+        // Signed compares: bytes >= 0x80 are negative, so never in A-Z
+        const __m128i below = _mm_set1_epi8('A' - 1);
+        const __m128i above = _mm_set1_epi8('Z' + 1);
+        const __m128i bit   = _mm_set1_epi8(0x20);
+        __m128i seen = _mm_setzero_si128();
+        for (; i + 16 <= size; i += 16) {
+            __m128i c     = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, below), _mm_cmplt_epi8(c, above));
+            seen = _mm_or_si128(seen, c);
+            c = _mm_or_si128(c, _mm_and_si128(upper, bit));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), c);
+        }
+        high = _mm_movemask_epi8(seen);
+#endif
+        for (; i < size; ++i) {
+            high |= data[i] & 0x80;
+            if (data[i] >= 'A' && data[i] <= 'Z') data[i] = static_cast<char>(data[i] | 0x20);
+        }
+        return high != 0;
+    }
+
+    void toLowerInPlace(char* data, size_t size) {
+        lowerAscii(data, size);
+    }
+
+    std::string toLower(std::string_view s) {
+        std::string result(s);
+        toLowerInPlace(result);
+        return result;
+    }
+
+    static constexpr std::string_view WHITESPACE = " \t\r\n";
+
+    std::string_view trim(std::string_view s) {
+        auto start = s.find_first_not_of(WHITESPACE);
+        if (start == std::string_view::npos) return {};
+        auto end = s.find_last_not_of(WHITESPACE);
+        return s.substr(start, end - start + 1);
+    }
+
+    std::string normalize(std::string_view s) {
+        std::string result(trim(s));
+        normalizeInPlace(result);
+        return result;
+    }
+
+    void normalizeInPlace(std::string& s) {
+        std::string_view t = trim(s);
+        if (t.size() != s.size()) {
+            if (!t.empty()) std::memmove(s.data(), t.data(), t.size());   // never grows: no allocation
+            s.resize(t.size());
+        }
+        if (lowerAscii(s.data(), s.size())) s.resize(Utf8::foldInPlace(s.data(), s.size()));
+    }
+
+    uint64_t randomSeed() {
+        static const uint64_t base = [] {
+            std::random_device device;
+            uint64_t high = device(), low = device();
+            return (high << 32 | low) ^ static_cast<uint64_t>(
+                std::chrono::steady_clock::now().time_since_epoch().count());
+        }();
+        static std::atomic<uint64_t> counter{0};
+
+        // splitmix64 over base + n·φ: consecutive seeds share no bits
+        uint64_t z = base + counter.fetch_add(1, std::memory_order_relaxed) * 0x9E3779B97F4A7C15u;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9u;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBu;
+        return z ^ (z >> 31);
+    }
+
+    void appendDateTime(std::string& out) {
+        auto now = std::chrono::system_clock::now();
+        std::time_t t = std::chrono::system_clock::to_time_t(now);
+        std::tm tm{};
+#ifdef _WIN32
+        localtime_s(&tm, &t);
+#else
+        localtime_r(&t, &tm);   // std::localtime is not thread-safe
+#endif
+        char buf[96];
+        out.append(buf, std::strftime(buf, sizeof buf, "%A, %B %d, %Y  %I:%M:%S %p", &tm));
+    }
+
+    void appendDuration(std::string& out, std::chrono::seconds sec) {
+        auto h = std::chrono::duration_cast<std::chrono::hours>(sec);
+        sec -= std::chrono::duration_cast<std::chrono::seconds>(h);
+        auto m = std::chrono::duration_cast<std::chrono::minutes>(sec);
+        sec -= std::chrono::duration_cast<std::chrono::seconds>(m);
+        char buf[64];
+        int n = std::snprintf(buf, sizeof buf, "%lldh %lldm %llds", static_cast<long long>(h.count()),
+                              static_cast<long long>(m.count()), static_cast<long long>(sec.count()));
+        out.append(buf, static_cast<size_t>(n));
+    }
+
+    std::string currentDateTime() {
+        std::string out;
+        appendDateTime(out);
+        return out;
+    }
+
+    std::string formatDuration(std::chrono::seconds sec) {
+        std::string out;
+        appendDuration(out, sec);
+        return out;
+    }
+
+#ifdef DEBUG
+    static thread_local uint64_t t_allocations = 0;
+    static thread_local uint64_t t_atLookup = 0;
+
+    uint64_t allocationCount() { return t_allocations; }
+    void     markLookup() { t_atLookup = t_allocations; }
+    uint64_t allocationsAtLookup() { return t_atLookup; }
+#endif
+}
+
+#ifdef DEBUG
+// ─── Allocation Counter ─────────────────────────────────────────
+// Replacing the global operator new counts every heap allocation the
+// standard library makes on our behalf. The array and nothrow forms
+// forward here by default.
+
+void* operator new(std::size_t size) {
+    ++Util::t_allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    ++Util::t_allocations;
+    std::size_t a = static_cast<std::size_t>(align);
+    if (void* p = std::aligned_alloc(a, (size + a - 1) / a * a)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#endif
@@ -0,0 +1,58 @@
+/**
+ *  util.hpp — Text and time helpers shared by the engine and front ends
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Util {
+
+    // ASCII lowercase in place, 16 bytes per step where SSE2 is
+    // available; bytes outside A-Z (including UTF-8) are left alone
+    void toLowerInPlace(char* data, size_t size);
+    inline void toLowerInPlace(std::string& s) { toLowerInPlace(s.data(), s.size()); }
+
+    std::string      toLower(std::string_view s);
+    std::string_view trim(std::string_view s);        // view into `s`
+    std::string      normalize(std::string_view s);   // trimmed, case-folded copy
+
+    // normalize() without allocating: trims and case-folds `s` itself.
+    // ASCII-only text is only lowercased; anything else is also folded
+    // and cleaned of malformed UTF-8 (see utf8.hpp). This is the
+    // per-message path; see allocationCount().
+    void normalizeInPlace(std::string& s);
+
+    // True if `s` is `prefix` followed by at least one more byte
+    constexpr bool startsWith(std::string_view s, std::string_view prefix) {
+        return s.size() > prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+    }
+
+#ifdef DEBUG
+    // Heap allocations made by the calling thread so far. Debug builds
+    // (make debug) count every operator new, so a code path can be
+    // checked for allocations by comparing two readings.
+    uint64_t allocationCount();
+
+    // allocationCount() as respond() read it after its latest knowledge
+    // lookup on this thread. Kept here rather than in Response, so the
+    // public struct is the same in every build.
+    void     markLookup();
+    uint64_t allocationsAtLookup();
+#endif
+
+    // Seed for a new session's Random: different on every call and in
+    // every run. Thread-safe.
+    uint64_t randomSeed();
+
+    std::string currentDateTime();
+    std::string formatDuration(std::chrono::seconds sec);   // "1h 2m 3s"
+
+    // The same, appended to `out` (no allocation once it has room)
+    void appendDateTime(std::string& out);
+    void appendDuration(std::string& out, std::chrono::seconds sec);
+}